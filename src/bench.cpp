@@ -0,0 +1,96 @@
+#include "bench.h"
+#include "board.h"
+#include "move.h"
+#include "nnue.h"
+#include "search.h"
+#include "tt.h"
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+using std::cout;
+
+constexpr int BENCH_DEPTH = 7;
+constexpr size_t BENCH_HASH_MB = 16;
+
+// a spread of openings, middlegames and endgames
+const char *bench_positions[] = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "r1bq1rk1/pp2bppp/2n1pn2/3p4/2PP4/2N1PN2/PP3PPP/R2QKB1R w KQ - 0 8",
+    "r2q1rk1/pb1nbppp/1p2pn2/2pp4/3P4/1P1BPN2/PBPN1PPP/R2Q1RK1 w - - 0 10",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    "6k1/5ppp/8/8/8/8/5PPP/3R2K1 w - - 0 1",
+};
+
+// chess_engine bench [depth] [network] [--no-null-move] [--no-lmr]
+//                    [--no-futility]
+int bench_command(int argc, char *argv[]) {
+  int depth = BENCH_DEPTH;
+  std::string network;
+  SearchOptions options;
+  int positional = 0;
+  for (int i = 0; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--no-null-move") {
+      options.null_move = false;
+    } else if (arg == "--no-lmr") {
+      options.late_move_reductions = false;
+    } else if (arg == "--no-futility") {
+      options.futility = false;
+    } else if (positional++ == 0) {
+      depth = std::atoi(argv[i]);
+    } else {
+      network = arg;
+    }
+  }
+  if (depth < 1) {
+    cout << "usage: chess_engine bench [depth] [network] [--no-null-move] "
+            "[--no-lmr] [--no-futility]\n";
+    return 1;
+  }
+
+  // the network has to be in place before any Board is set up
+  if (!network.empty() && !nnue_load(network)) {
+    cout << "Could not load network: " << network << '\n';
+    return 1;
+  }
+  cout << "Evaluation: " << (nnue_enabled ? "nnue" : "classical") << '\n';
+
+  tt.resize(BENCH_HASH_MB);
+
+  uint64_t total_nodes = 0;
+  uint64_t pawn_probes = 0, pawn_hits = 0;
+  double total_seconds = 0;
+  for (const char *fen : bench_positions) {
+    Board board;
+    board.set_fen(fen);
+    tt.clear();
+
+    SearchLimits limits;
+    limits.depth = depth;
+    limits.options = options;
+    SearchResult result = search(board, limits, tt);
+
+    cout << move_to_string(result.best_move) << " score " << result.score
+         << " nodes " << result.nodes << '\n';
+    if (stats_enabled) {
+      std::cerr << search_stats_json(result) << '\n';
+    }
+    total_nodes += result.nodes;
+    total_seconds += result.seconds;
+    pawn_probes += result.pawn_probes;
+    pawn_hits += result.pawn_hits;
+  }
+
+  cout << "\nNodes: " << total_nodes << '\n';
+  cout << "Time: " << (int)(total_seconds * 1000) << " ms\n";
+  cout << "NPS: " << (uint64_t)(total_nodes / std::max(total_seconds, 0.001))
+       << '\n';
+  // tells whether PAWN_TABLE_ENTRIES is big enough
+  if (pawn_probes > 0) {
+    cout << "Pawn hash hits: " << 100.0 * pawn_hits / pawn_probes << "%\n";
+  }
+  return 0;
+}
@@ -0,0 +1,10 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+// Entry point for "chess_engine bench [depth] [network]": searches a fixed
+// set of positions to depth and prints nodes, time and nodes per second. With
+// a network file the NNUE evaluation is used, otherwise the classical one, so
+// running it both ways compares the two. Returns the process exit code.
+int bench_command(int argc, char *argv[]);
+
+#endif
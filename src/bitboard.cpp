@@ -0,0 +1,163 @@
+#include "bitboard.h"
+
+Magic rook_magics[64];
+Magic bishop_magics[64];
+
+Bitboard knight_attacks[64];
+Bitboard king_attacks[64];
+Bitboard pawn_attacks[2][64];
+Bitboard between_bb[64][64];
+Bitboard line_bb[64][64];
+
+// 102400 rook entries + 5248 bishop entries, every square gets 2^bits of them
+static Bitboard rook_table[0x19000];
+static Bitboard bishop_table[0x1480];
+
+static uint64_t prng_state = 1070372ULL;
+
+// magics need few set bits to work well
+static uint64_t sparse_random_u64() {
+  return random_u64(prng_state) & random_u64(prng_state) &
+         random_u64(prng_state);
+}
+
+// adds square (row, column) to b if it is on the board
+static void add_if_on_board(Bitboard &b, int row, int column) {
+  if (row >= 0 && row < 8 && column >= 0 && column < 8) {
+    b |= square_bb(row * 8 + column);
+  }
+}
+
+// walk the rays one square at a time, only used to fill the tables
+static Bitboard slow_slider_attacks(int square, Bitboard occupied,
+                                    const int directions[4][2]) {
+  Bitboard attacks = 0;
+  for (int i = 0; i < 4; ++i) {
+    int row = square / 8 + directions[i][0];
+    int column = square % 8 + directions[i][1];
+    while (row >= 0 && row < 8 && column >= 0 && column < 8) {
+      Bitboard b = square_bb(row * 8 + column);
+      attacks |= b;
+      if (occupied & b) {
+        break;
+      }
+      row += directions[i][0];
+      column += directions[i][1];
+    }
+  }
+  return attacks;
+}
+
+constexpr int rook_directions[4][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+constexpr int bishop_directions[4][2] = {{1, 1}, {1, -1}, {-1, 1}, {-1, -1}};
+
+static void init_magics(Magic magics[64], Bitboard *table,
+                        const int directions[4][2]) {
+  Bitboard occupancies[4096];
+  Bitboard references[4096];
+  int epoch[4096] = {0};
+  int attempt = 0;
+
+  for (int square = 0; square < 64; ++square) {
+    Magic &m = magics[square];
+
+    // the edge squares never block anything further along the ray
+    Bitboard edges =
+        ((RANK_1_BB | RANK_8_BB) & ~(RANK_1_BB << (square / 8 * 8))) |
+        ((FILE_A_BB | FILE_H_BB) & ~(FILE_A_BB << (square % 8)));
+    m.mask = slow_slider_attacks(square, 0, directions) & ~edges;
+    m.shift = 64 - popcount(m.mask);
+    m.attacks = table;
+
+    // enumerate every subset of the mask (carry-rippler trick)
+    int size = 0;
+    Bitboard b = 0;
+    do {
+      occupancies[size] = b;
+      references[size] = slow_slider_attacks(square, b, directions);
+      ++size;
+      b = (b - m.mask) & m.mask;
+    } while (b);
+
+    // try random magics until one maps every subset without a bad collision
+    for (int i = 0; i < size;) {
+      m.magic = 0;
+      while (popcount((m.mask * m.magic) >> 56) < 6) {
+        m.magic = sparse_random_u64();
+      }
+
+      ++attempt;
+      for (i = 0; i < size; ++i) {
+        unsigned idx = m.index(occupancies[i]);
+        if (epoch[idx] < attempt) {
+          epoch[idx] = attempt;
+          m.attacks[idx] = references[i];
+        } else if (m.attacks[idx] != references[i]) {
+          break;
+        }
+      }
+    }
+
+    table += size;
+  }
+}
+
+static bool build_tables() {
+  for (int square = 0; square < 64; ++square) {
+    int row = square / 8;
+    int column = square % 8;
+
+    constexpr int knight_offsets[8][2] = {{2, 1},   {2, -1}, {-2, 1},
+                                          {-2, -1}, {1, 2},  {1, -2},
+                                          {-1, 2},  {-1, -2}};
+    knight_attacks[square] = 0;
+    for (const auto &o : knight_offsets) {
+      add_if_on_board(knight_attacks[square], row + o[0], column + o[1]);
+    }
+
+    king_attacks[square] = 0;
+    for (int dr = -1; dr <= 1; ++dr) {
+      for (int dc = -1; dc <= 1; ++dc) {
+        if (dr != 0 || dc != 0) {
+          add_if_on_board(king_attacks[square], row + dr, column + dc);
+        }
+      }
+    }
+
+    pawn_attacks[0][square] = 0; // WHITE
+    pawn_attacks[1][square] = 0; // BLACK
+    add_if_on_board(pawn_attacks[0][square], row + 1, column - 1);
+    add_if_on_board(pawn_attacks[0][square], row + 1, column + 1);
+    add_if_on_board(pawn_attacks[1][square], row - 1, column - 1);
+    add_if_on_board(pawn_attacks[1][square], row - 1, column + 1);
+  }
+
+  init_magics(rook_magics, rook_table, rook_directions);
+  init_magics(bishop_magics, bishop_table, bishop_directions);
+
+  for (int a = 0; a < 64; ++a) {
+    for (int b = 0; b < 64; ++b) {
+      between_bb[a][b] = line_bb[a][b] = 0;
+      Bitboard ends = square_bb(a) | square_bb(b);
+      if (a == b) {
+        continue;
+      }
+      if (rook_attacks(a, 0) & square_bb(b)) {
+        line_bb[a][b] = (rook_attacks(a, 0) & rook_attacks(b, 0)) | ends;
+        between_bb[a][b] =
+            rook_attacks(a, square_bb(b)) & rook_attacks(b, square_bb(a));
+      } else if (bishop_attacks(a, 0) & square_bb(b)) {
+        line_bb[a][b] = (bishop_attacks(a, 0) & bishop_attacks(b, 0)) | ends;
+        between_bb[a][b] =
+            bishop_attacks(a, square_bb(b)) & bishop_attacks(b, square_bb(a));
+      }
+    }
+  }
+  return true;
+}
+
+void init_bitboards() {
+  // function-local static, so concurrent first calls still build once
+  static const bool initialized = build_tables();
+  (void)initialized;
+}
@@ -0,0 +1,79 @@
+#ifndef BITBOARD_H
+#define BITBOARD_H
+
+#include <cstdint>
+
+// one bit per square, bit index is the same row*8+column as Board::pieces
+typedef uint64_t Bitboard;
+
+constexpr Bitboard FILE_A_BB = 0x0101010101010101ULL;
+constexpr Bitboard FILE_H_BB = FILE_A_BB << 7;
+constexpr Bitboard RANK_1_BB = 0xFFULL;
+constexpr Bitboard RANK_8_BB = RANK_1_BB << 56;
+
+constexpr Bitboard square_bb(int square) { return 1ULL << square; }
+
+inline int popcount(Bitboard b) { return __builtin_popcountll(b); }
+
+// index of the lowest set bit, b must not be empty
+inline int lsb(Bitboard b) { return __builtin_ctzll(b); }
+
+// returns the lowest set bit and clears it from b
+inline int pop_lsb(Bitboard &b) {
+  int square = lsb(b);
+  b &= b - 1;
+  return square;
+}
+
+// xorshift64*, seeded by the caller so magics and zobrist keys come out the
+// same every run
+inline uint64_t random_u64(uint64_t &state) {
+  state ^= state >> 12;
+  state ^= state << 25;
+  state ^= state >> 27;
+  return state * 2685821657736338717ULL;
+}
+
+// everything a rook/bishop on a square needs to look up its attacks
+struct Magic {
+  Bitboard mask;     // relevant occupancy (ray squares minus the edges)
+  Bitboard magic;    // multiplier that hashes mask subsets perfectly
+  Bitboard *attacks; // slice of the shared attack table
+  int shift;         // 64 - number of bits in mask
+
+  unsigned index(Bitboard occupied) const {
+    return (unsigned)(((occupied & mask) * magic) >> shift);
+  }
+};
+
+extern Magic rook_magics[64];
+extern Magic bishop_magics[64];
+
+extern Bitboard knight_attacks[64];
+extern Bitboard king_attacks[64];
+extern Bitboard pawn_attacks[2][64]; // [side][square], squares a pawn hits
+
+// for two squares on a shared rank, file or diagonal: the squares strictly
+// between them, and the whole line through both edge to edge. 0 otherwise.
+extern Bitboard between_bb[64][64];
+extern Bitboard line_bb[64][64];
+
+inline Bitboard rook_attacks(int square, Bitboard occupied) {
+  const Magic &m = rook_magics[square];
+  return m.attacks[m.index(occupied)];
+}
+
+inline Bitboard bishop_attacks(int square, Bitboard occupied) {
+  const Magic &m = bishop_magics[square];
+  return m.attacks[m.index(occupied)];
+}
+
+inline Bitboard queen_attacks(int square, Bitboard occupied) {
+  return rook_attacks(square, occupied) | bishop_attacks(square, occupied);
+}
+
+// Builds the attack tables and finds the magics. Safe to call more than once,
+// the work is only done the first time.
+void init_bitboards();
+
+#endif
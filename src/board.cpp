@@ -1,27 +1,22 @@
 #include "board.h"
 #include "move.h"
+#include "bitboard.h"
+#include "eval.h"
+#include "pawns.h"
+#include "search.h"
+#include "tt.h"
+#include "zobrist.h"
 #include <algorithm>
 #include <cmath>
 #include <iostream>
-#include <vector>
+#include <sstream>
 
-using std::abs;
 using std::cout;
 
 struct Move;
 
-constexpr int INFINITY_SCORE = 1000000;
-constexpr int CHECKMATE_SCORE = 999999;
-
-constexpr int piece_values[13] = {
-    100,  300, 300, 500, 900, 0, -100, // B_
-    -300,                              // B_KNIGHT
-    -300,                              // B_BISHOP
-    -500,                              // B_QUEEN
-    -900,                              // B_QUEEN
-    0,                                 // B_KING
-    0                                  // EMPTY
-};
+// exchange values by piece type, the king outweighs anything it could win
+constexpr int see_values[6] = {100, 300, 300, 500, 900, 20000};
 
 char get_piece_char(Piece p) {
   switch (p) {
@@ -57,42 +52,260 @@ char get_piece_char(Piece p) {
 }
 
 Board::Board() {
-  for (int i = 0; i < 64; ++i) {
-    pieces[i] = EMPTY;
-  }
+  init_bitboards();
+  init_zobrist();
+  init_eval();
+  init_pawns();
+  clear();
+
   // white main pieces
-  pieces[0] = W_ROOK;
-  pieces[1] = W_KNIGHT;
-  pieces[2] = W_BISHOP;
-  pieces[3] = W_QUEEN;
-  pieces[4] = W_KING;
-  pieces[5] = W_BISHOP;
-  pieces[6] = W_KNIGHT;
-  pieces[7] = W_ROOK;
+  put_piece(0, W_ROOK);
+  put_piece(1, W_KNIGHT);
+  put_piece(2, W_BISHOP);
+  put_piece(3, W_QUEEN);
+  put_piece(4, W_KING);
+  put_piece(5, W_BISHOP);
+  put_piece(6, W_KNIGHT);
+  put_piece(7, W_ROOK);
 
   // white pawns
   for (int i = 8; i < 16; ++i) {
-    pieces[i] = W_PAWN;
+    put_piece(i, W_PAWN);
   }
 
   // black main pieces
-  pieces[56] = B_ROOK;
-  pieces[57] = B_KNIGHT;
-  pieces[58] = B_BISHOP;
-  pieces[59] = B_QUEEN;
-  pieces[60] = B_KING;
-  pieces[61] = B_BISHOP;
-  pieces[62] = B_KNIGHT;
-  pieces[63] = B_ROOK;
+  put_piece(56, B_ROOK);
+  put_piece(57, B_KNIGHT);
+  put_piece(58, B_BISHOP);
+  put_piece(59, B_QUEEN);
+  put_piece(60, B_KING);
+  put_piece(61, B_BISHOP);
+  put_piece(62, B_KNIGHT);
+  put_piece(63, B_ROOK);
 
   // black pawns
   for (int i = 48; i < 56; ++i) {
-    pieces[i] = B_PAWN;
+    put_piece(i, B_PAWN);
   }
 
   side_to_move = WHITE;                // Start with white
   en_passant_square = -1;              // No enpassant_square at the start
   castling_rights = WK | WQ | BK | BQ; // All rights should be available (1111)
+  hash_key = compute_hash();
+}
+
+void Board::clear() {
+  for (int i = 0; i < 64; ++i) {
+    pieces[i] = EMPTY;
+  }
+  for (int i = 0; i < 12; ++i) {
+    piece_bb[i] = 0;
+  }
+  side_bb[WHITE] = side_bb[BLACK] = 0;
+  occupied = 0;
+  king_square[WHITE] = king_square[BLACK] = -1;
+  pawn_key = 0;
+  mg_score = eg_score = phase = 0;
+  if (nnue_enabled) {
+    nnue_reset(accumulator);
+  }
+
+  side_to_move = WHITE;
+  en_passant_square = -1;
+  castling_rights = 0;
+  halfmove_clock = 0;
+  history.clear();
+  hash_key = compute_hash();
+}
+
+bool Board::set_fen(const std::string &fen) {
+  std::istringstream in(fen);
+  std::string placement, side, castling, en_passant;
+  if (!(in >> placement >> side >> castling >> en_passant)) {
+    return false;
+  }
+
+  Board b = *this;
+  b.clear();
+
+  // placement starts at a8 and works down the ranks
+  int row = 7;
+  int column = 0;
+  for (char c : placement) {
+    if (c == '/') {
+      if (column != 8 || row == 0) {
+        return false;
+      }
+      --row;
+      column = 0;
+    } else if (c >= '1' && c <= '8') {
+      column += c - '0';
+    } else {
+      const std::string piece_chars = "PNBRQKpnbrqk";
+      size_t p = piece_chars.find(c);
+      if (p == std::string::npos || column > 7) {
+        return false;
+      }
+      b.put_piece(row * 8 + column, (Piece)p);
+      ++column;
+    }
+    if (column > 8) {
+      return false;
+    }
+  }
+  if (row != 0 || column != 8) {
+    return false;
+  }
+  if (popcount(b.piece_bb[W_KING]) != 1 || popcount(b.piece_bb[B_KING]) != 1) {
+    return false;
+  }
+  // a pawn on the first or last rank would move off the board
+  if ((b.piece_bb[W_PAWN] | b.piece_bb[B_PAWN]) & (RANK_1_BB | RANK_8_BB)) {
+    return false;
+  }
+
+  if (side == "w") {
+    b.side_to_move = WHITE;
+  } else if (side == "b") {
+    b.side_to_move = BLACK;
+  } else {
+    return false;
+  }
+
+  if (castling != "-") {
+    for (char c : castling) {
+      switch (c) {
+      case 'K':
+        b.castling_rights |= WK;
+        break;
+      case 'Q':
+        b.castling_rights |= WQ;
+        break;
+      case 'k':
+        b.castling_rights |= BK;
+        break;
+      case 'q':
+        b.castling_rights |= BQ;
+        break;
+      default:
+        return false;
+      }
+    }
+  }
+
+  // the side that just moved can't have left its king in check, the moves
+  // from here would include taking it
+  Side them = b.side_to_move == WHITE ? BLACK : WHITE;
+  if (b.is_square_attacked(b.king_square[them], b.side_to_move)) {
+    return false;
+  }
+
+  // a right is only kept while its king and rook are still at home, castling
+  // without them would move pieces that aren't there
+  struct CastlingHome {
+    int right, king_square, rook_square;
+    Piece king, rook;
+  };
+  constexpr CastlingHome homes[4] = {{WK, 4, 7, W_KING, W_ROOK},
+                                     {WQ, 4, 0, W_KING, W_ROOK},
+                                     {BK, 60, 63, B_KING, B_ROOK},
+                                     {BQ, 60, 56, B_KING, B_ROOK}};
+  for (const CastlingHome &home : homes) {
+    if (b.pieces[home.king_square] != home.king ||
+        b.pieces[home.rook_square] != home.rook) {
+      b.castling_rights &= ~home.right;
+    }
+  }
+
+  if (en_passant != "-") {
+    if (en_passant.size() != 2 || en_passant[0] < 'a' || en_passant[0] > 'h' ||
+        (en_passant[1] != '3' && en_passant[1] != '6')) {
+      return false;
+    }
+    int square = (en_passant[1] - '1') * 8 + (en_passant[0] - 'a');
+    // only kept behind a pawn of the side not to move that could just have
+    // made a double push, otherwise there is nothing to take
+    int pawn_square = b.side_to_move == WHITE ? square - 8 : square + 8;
+    Piece their_pawn = b.side_to_move == WHITE ? B_PAWN : W_PAWN;
+    bool ahead_of_pawn = b.side_to_move == WHITE ? en_passant[1] == '6'
+                                                 : en_passant[1] == '3';
+    if (ahead_of_pawn && b.pieces[pawn_square] == their_pawn &&
+        b.pieces[square] == EMPTY) {
+      b.en_passant_square = square;
+    }
+  }
+
+  // the clocks can be left off, and then start at zero
+  int halfmove;
+  if (in >> halfmove) {
+    if (halfmove < 0) {
+      return false;
+    }
+    b.halfmove_clock = halfmove;
+  }
+
+  b.hash_key = b.compute_hash();
+  *this = b;
+  return true;
+}
+
+void Board::set_pieces(const Piece list[], const int squares[], int count,
+                       Side side) {
+  clear();
+  for (int i = 0; i < count; ++i) {
+    put_piece(squares[i], list[i]);
+  }
+  side_to_move = side;
+  hash_key = compute_hash();
+}
+
+std::string Board::to_fen() const {
+  const std::string piece_chars = "PNBRQKpnbrqk";
+  std::string fen;
+
+  for (int row = 7; row >= 0; --row) {
+    int empty = 0;
+    for (int column = 0; column < 8; ++column) {
+      Piece p = pieces[row * 8 + column];
+      if (p == EMPTY) {
+        ++empty;
+        continue;
+      }
+      if (empty > 0) {
+        fen += (char)('0' + empty);
+        empty = 0;
+      }
+      fen += piece_chars[p];
+    }
+    if (empty > 0) {
+      fen += (char)('0' + empty);
+    }
+    if (row > 0) {
+      fen += '/';
+    }
+  }
+
+  fen += side_to_move == WHITE ? " w " : " b ";
+
+  if (castling_rights == 0) {
+    fen += '-';
+  } else {
+    fen += castling_rights & WK ? "K" : "";
+    fen += castling_rights & WQ ? "Q" : "";
+    fen += castling_rights & BK ? "k" : "";
+    fen += castling_rights & BQ ? "q" : "";
+  }
+
+  if (en_passant_square == -1) {
+    fen += " -";
+  } else {
+    fen += ' ';
+    fen += (char)('a' + en_passant_square % 8);
+    fen += (char)('1' + en_passant_square / 8);
+  }
+
+  fen += ' ' + std::to_string(halfmove_clock) + " 1";
+  return fen;
 }
 
 void Board::print_board() {
@@ -119,6 +332,90 @@ void Board::print_board() {
   cout << "En Passant: "
        << (en_passant_square == -1 ? "none" : std::to_string(en_passant_square))
        << '\n';
+  cout << "FEN: " << to_fen() << '\n';
+}
+
+void Board::put_piece(int square, Piece p) {
+  Bitboard b = square_bb(square);
+  pieces[square] = p;
+  piece_bb[p] |= b;
+  side_bb[get_piece_side(p)] |= b;
+  occupied |= b;
+  hash_key ^= zobrist_pieces[p][square];
+  if (p == W_PAWN || p == B_PAWN) {
+    pawn_key ^= zobrist_pieces[p][square];
+  }
+  mg_score += mg_table[p][square];
+  eg_score += eg_table[p][square];
+  phase += phase_weight[p];
+  if (nnue_enabled) {
+    nnue_add_piece(accumulator, p, square);
+  }
+  if (p == W_KING || p == B_KING) {
+    king_square[get_piece_side(p)] = square;
+  }
+}
+
+void Board::remove_piece(int square) {
+  Piece p = pieces[square];
+  Bitboard b = square_bb(square);
+  pieces[square] = EMPTY;
+  piece_bb[p] &= ~b;
+  side_bb[get_piece_side(p)] &= ~b;
+  occupied &= ~b;
+  hash_key ^= zobrist_pieces[p][square];
+  if (p == W_PAWN || p == B_PAWN) {
+    pawn_key ^= zobrist_pieces[p][square];
+  }
+  mg_score -= mg_table[p][square];
+  eg_score -= eg_table[p][square];
+  phase -= phase_weight[p];
+  if (nnue_enabled) {
+    nnue_remove_piece(accumulator, p, square);
+  }
+  if (p == W_KING || p == B_KING) {
+    king_square[get_piece_side(p)] = -1;
+  }
+}
+
+void Board::move_piece(int from, int to) {
+  Piece p = pieces[from];
+  Bitboard from_to = square_bb(from) | square_bb(to);
+  pieces[to] = p;
+  pieces[from] = EMPTY;
+  piece_bb[p] ^= from_to;
+  side_bb[get_piece_side(p)] ^= from_to;
+  occupied ^= from_to;
+  hash_key ^= zobrist_pieces[p][from] ^ zobrist_pieces[p][to];
+  if (p == W_PAWN || p == B_PAWN) {
+    pawn_key ^= zobrist_pieces[p][from] ^ zobrist_pieces[p][to];
+  }
+  mg_score += mg_table[p][to] - mg_table[p][from];
+  eg_score += eg_table[p][to] - eg_table[p][from];
+  if (nnue_enabled) {
+    nnue_move_piece(accumulator, p, from, to);
+  }
+  if (p == W_KING || p == B_KING) {
+    king_square[get_piece_side(p)] = to;
+  }
+}
+
+uint64_t Board::compute_hash() const {
+  uint64_t key = 0;
+  for (int p = 0; p < 12; ++p) {
+    Bitboard b = piece_bb[p];
+    while (b) {
+      key ^= zobrist_pieces[p][pop_lsb(b)];
+    }
+  }
+  if (side_to_move == BLACK) {
+    key ^= zobrist_side;
+  }
+  key ^= zobrist_castling[castling_rights];
+  if (en_passant_square != -1) {
+    key ^= zobrist_en_passant[en_passant_square % 8];
+  }
+  return key;
 }
 
 Side Board::get_piece_side(Piece p) const {
@@ -131,642 +428,614 @@ Side Board::get_piece_side(Piece p) const {
   return (Side)-1;
 }
 
-bool Board::is_our_piece(Piece p) const {
-  return get_piece_side(p) == side_to_move;
+void Board::generate_pseudo_legal_moves(MoveList &moves) const {
+  generate_moves(moves, false);
+}
+
+void Board::generate_pseudo_legal_captures(MoveList &moves) const {
+  generate_moves(moves, true);
+}
+
+Bitboard Board::move_targets(bool captures_only) const {
+  return captures_only ? side_bb[side_to_move == WHITE ? BLACK : WHITE]
+                       : ~side_bb[side_to_move];
+}
+
+void Board::generate_moves(MoveList &moves, bool captures_only) const {
+  moves.clear();
+  // first piece of our colour, the rest follow in the same order as Piece
+  int first = (side_to_move == WHITE) ? W_PAWN : B_PAWN;
+  Bitboard targets = move_targets(captures_only);
+
+  for (int type = 0; type < 6; ++type) {
+    Bitboard b = piece_bb[first + type];
+    while (b) {
+      int square = pop_lsb(b);
+      switch (type) {
+      case W_PAWN:
+        generate_pawn_moves(square, moves, captures_only, ~0ULL);
+        break;
+
+      case W_KNIGHT:
+        generate_knight_moves(square, moves, targets);
+        break;
+
+      case W_KING:
+        generate_king_moves(square, moves, captures_only);
+        break;
+
+      default: // rook, bishop, queen
+        generate_sliding_moves(square, moves, targets);
+        break;
+      }
+    }
+  }
 }
 
-bool Board::is_opponent_piece(Piece p) const {
-  Side piece_side = get_piece_side(p);
-  return piece_side != (Side)-1 && piece_side != side_to_move;
+Bitboard Board::pinned_pieces(int king_sq) const {
+  Side us = side_to_move;
+  int first = (us == WHITE) ? B_PAWN : W_PAWN; // their pieces
+  Bitboard queens = piece_bb[first + W_QUEEN];
+
+  // enemy sliders that would hit the king on an empty board
+  Bitboard snipers =
+      (rook_attacks(king_sq, 0) & (piece_bb[first + W_ROOK] | queens)) |
+      (bishop_attacks(king_sq, 0) & (piece_bb[first + W_BISHOP] | queens));
+
+  Bitboard pinned = 0;
+  while (snipers) {
+    Bitboard blockers = between_bb[king_sq][pop_lsb(snipers)] & occupied;
+    // exactly one piece in the way, and it's ours
+    if (blockers && !(blockers & (blockers - 1)) && (blockers & side_bb[us])) {
+      pinned |= blockers;
+    }
+  }
+  return pinned;
 }
 
-void Board::generate_pseudo_legal_moves(std::vector<Move> &moves) const {
+void Board::generate_legal(MoveList &moves, bool captures_only) const {
   moves.clear();
-  for (int square = 0; square < 64; ++square) {
-    Piece p = pieces[square];
-    if (p == EMPTY ||
-        !is_our_piece(p)) { // skip if the piece on the square is empty
-      continue;
+
+  Side us = side_to_move;
+  Side them = (us == WHITE) ? BLACK : WHITE;
+  int first = (us == WHITE) ? W_PAWN : B_PAWN;
+  int king_sq = king_square[us];
+
+  Bitboard checkers = attackers_to(king_sq, occupied) & side_bb[them];
+
+  // the king can go anywhere not attacked once it has moved, so take it off
+  // the board first or it would hide squares behind itself from sliders
+  Bitboard without_king = occupied ^ square_bb(king_sq);
+  Bitboard king_targets =
+      king_attacks[king_sq] & move_targets(captures_only);
+  while (king_targets) {
+    int to = pop_lsb(king_targets);
+    if (!(attackers_to(to, without_king) & side_bb[them])) {
+      moves.push_back(Move(king_sq, to, capture_flag(to)));
     }
-    switch (p) {
-    case W_PAWN:
-    case B_PAWN:
-      generate_pawn_moves(square, moves);
-      break;
+  }
 
-    case W_KNIGHT:
-    case B_KNIGHT:
-      generate_knight_moves(square, moves);
-      break;
+  // in double check only the king can move
+  if (checkers & (checkers - 1)) {
+    return;
+  }
 
-    case W_KING:
-    case B_KING:
-      generate_king_moves(square, moves);
-      break;
+  if (!checkers && !captures_only) {
+    generate_castling_moves(king_sq, moves);
+  }
 
-    case W_ROOK:
-    case B_ROOK:
-    case W_BISHOP:
-    case B_BISHOP:
-    case W_QUEEN:
-    case B_QUEEN:
-      generate_sliding_moves(square, moves);
-      break;
-    default:
-      break;
+  // in check, everything else has to capture the checker or block it
+  Bitboard check_mask = ~0ULL;
+  if (checkers) {
+    check_mask = between_bb[king_sq][lsb(checkers)] | checkers;
+  }
+  Bitboard targets = move_targets(captures_only) & check_mask;
+  Bitboard pinned = pinned_pieces(king_sq);
+
+  for (int type = 0; type < 5; ++type) {
+    Bitboard b = piece_bb[first + type];
+    while (b) {
+      int square = pop_lsb(b);
+
+      // a pinned piece may only move along the line of the pin
+      Bitboard pin_mask = ~0ULL;
+      if (pinned & square_bb(square)) {
+        pin_mask = line_bb[king_sq][square];
+      }
+
+      switch (type) {
+      case W_PAWN:
+        generate_pawn_moves(square, moves, captures_only,
+                            check_mask & pin_mask);
+        break;
+
+      case W_KNIGHT:
+        generate_knight_moves(square, moves, targets & pin_mask);
+        break;
+
+      default: // rook, bishop, queen
+        generate_sliding_moves(square, moves, targets & pin_mask);
+        break;
+      }
     }
   }
 }
 
-void Board::add_pawn_move(int from, int to, std::vector<Move> &moves) const {
+void Board::add_pawn_move(int from, int to, MoveList &moves) const {
   int promotion_rank = (side_to_move == WHITE) ? 7 : 0;
   int to_row = to / 8;
+  bool capture = pieces[to] != EMPTY;
 
   if (to_row == promotion_rank) {
-    moves.push_back(
-        Move(from, to, (side_to_move == WHITE ? W_QUEEN : B_QUEEN)));
-    moves.push_back(Move(from, to, (side_to_move == WHITE ? W_ROOK : B_ROOK)));
-    moves.push_back(
-        Move(from, to, (side_to_move == WHITE ? W_BISHOP : B_BISHOP)));
-    moves.push_back(
-        Move(from, to, (side_to_move == WHITE ? W_KNIGHT : B_KNIGHT)));
+    moves.push_back(Move(from, to, promotion_flag(W_QUEEN, capture)));
+    moves.push_back(Move(from, to, promotion_flag(W_ROOK, capture)));
+    moves.push_back(Move(from, to, promotion_flag(W_BISHOP, capture)));
+    moves.push_back(Move(from, to, promotion_flag(W_KNIGHT, capture)));
   } else { // regular move
-    moves.push_back(Move(from, to));
+    moves.push_back(Move(from, to, capture ? MOVE_CAPTURE : MOVE_QUIET));
   }
 }
 
-void Board::generate_pawn_moves(int square, std::vector<Move> &moves) const {
+bool Board::en_passant_is_legal(int from) const {
+  int to = en_passant_square;
+  int captured = (side_to_move == WHITE) ? to - 8 : to + 8;
+  Side them = (side_to_move == WHITE) ? BLACK : WHITE;
+  int king_sq = king_square[side_to_move];
+
+  // two pawns leave the same rank at once, which a pin mask can't describe,
+  // so play it out on the occupancy and look for attacks on the king
+  Bitboard occ =
+      (occupied ^ square_bb(from) ^ square_bb(captured)) | square_bb(to);
+  Bitboard attackers = side_bb[them] & ~square_bb(captured);
+  return !(attackers_to(king_sq, occ) & attackers);
+}
+
+void Board::generate_pawn_moves(int square, MoveList &moves,
+                                bool captures_only, Bitboard mask) const {
   int dir = (side_to_move == WHITE) ? 1 : -1;
   int start_row = (side_to_move == WHITE) ? 1 : 6;
+  int promotion_row = (side_to_move == WHITE) ? 7 : 0;
   int current_row = square / 8;
-  int current_column = square % 8;
 
-  // Single square move
+  // Single square move, a pawn is never on the last rank so this stays on
+  // the board. Promotions count as captures for quiescence.
   int single_move = square + 8 * dir;
-  if (single_move > -0 && single_move < 64 && pieces[single_move] == EMPTY) {
-    add_pawn_move(square, single_move, moves);
+  if (pieces[single_move] == EMPTY &&
+      (!captures_only || single_move / 8 == promotion_row)) {
+    if (mask & square_bb(single_move)) {
+      add_pawn_move(square, single_move, moves);
+    }
 
     // check if pawn can move two spots
-
-    if (current_row == start_row) {
+    if (!captures_only && current_row == start_row) {
       int double_move = square + 16 * dir;
-      if (pieces[double_move] == EMPTY) {
-        moves.push_back(Move(square, double_move));
+      if (pieces[double_move] == EMPTY && (mask & square_bb(double_move))) {
+        moves.push_back(Move(square, double_move, MOVE_DOUBLE_PUSH));
       }
     }
   }
 
-  // capturing
-  int capture_left = square + 8 * dir - 1;
-  if (capture_left >= 0 && capture_left < 64 &&
-      (capture_left % 8) == current_column - 1) {
-    if (is_opponent_piece(pieces[capture_left])) {
-      add_pawn_move(square, capture_left, moves);
-    }
-  }
-
-  int capture_right = square + 8 * dir + 1;
-  if (capture_right >= 0 && capture_right < 64 &&
-      (capture_right % 8) == current_column + 1) {
-    if (is_opponent_piece(pieces[capture_right])) {
-      add_pawn_move(square, capture_right, moves);
-    }
+  // capturing, the attack table already excludes wrapping round the board
+  Bitboard attacks = pawn_attacks[side_to_move][square];
+  Bitboard captures =
+      attacks & side_bb[side_to_move == WHITE ? BLACK : WHITE] & mask;
+  while (captures) {
+    add_pawn_move(square, pop_lsb(captures), moves);
   }
 
-  // en passant
-  if (en_passant_square != -1) {
-    if (capture_left == en_passant_square) {
-      moves.push_back(Move(square, en_passant_square));
-    }
-    if (capture_right == en_passant_square) {
-      moves.push_back(Move(square, en_passant_square));
-    }
+  // en passant, checked separately since mask doesn't cover it
+  if (en_passant_square != -1 && (attacks & square_bb(en_passant_square)) &&
+      en_passant_is_legal(square)) {
+    moves.push_back(Move(square, en_passant_square, MOVE_EN_PASSANT));
   }
 }
 
-void Board::generate_knight_moves(int square, std::vector<Move> &moves) const {
-  int from_row = square / 8;
-  int from_column = square % 8;
-
-  // diagonal movement
-  constexpr int offsets[8] = {-17, -15, -10, -6, 6, 10, 15, 17};
-
-  for (int offset : offsets) {
-    int to_square = square + offset;
-    if (to_square < 0 || to_square > 63) {
-      continue;
-    }
-    // check if its wrapping around ie) going from 16 -> 22
-    int to_row = to_square / 8;
-    int to_column = to_square % 8;
-
-    int row_diff = abs(to_row - from_row);
-    int column_diff = abs(to_column - from_column);
-
-    if (!((row_diff == 2 && column_diff == 1) ||
-          (row_diff == 1 && column_diff == 2))) {
-      continue;
-    }
-
-    if (!is_our_piece(pieces[to_square])) {
-      moves.push_back(Move(square, to_square));
-    }
+void Board::generate_knight_moves(int square, MoveList &moves,
+                                  Bitboard targets) const {
+  targets &= knight_attacks[square];
+  while (targets) {
+    int to = pop_lsb(targets);
+    moves.push_back(Move(square, to, capture_flag(to)));
   }
 }
 
-void Board::generate_king_moves(int square, std::vector<Move> &moves) const {
-  int from_row = square / 8;
-  int from_column = square % 8;
-
-  // one square movements both diagonal and straight
-  constexpr int offsets[8] = {-9, -8, -7, -1, 1, 7, 8, 9};
-
-  for (int offset : offsets) {
-    int to_square = square + offset;
-    if (to_square < 0 || to_square > 63) {
-      continue;
-    }
-    // check if its wrapping around ie) going from 16 -> 22
-    int to_row = to_square / 8;
-    int to_column = to_square % 8;
-
-    int row_diff = abs(to_row - from_row);          // diff of row
-    int column_diff = abs(to_column - from_column); // diff or column
-
-    // check if wraping
-    if (row_diff > 1 ||
-        column_diff >
-            1) { // row diff and column diff should not be greater than 1
-      continue;
-    }
+void Board::generate_king_moves(int square, MoveList &moves,
+                                bool captures_only) const {
+  Bitboard targets = king_attacks[square] & move_targets(captures_only);
+  while (targets) {
+    int to = pop_lsb(targets);
+    moves.push_back(Move(square, to, capture_flag(to)));
+  }
 
-    if (!is_our_piece(pieces[to_square])) {
-      moves.push_back(Move(square, to_square));
-    }
+  if (!captures_only) {
+    generate_castling_moves(square, moves);
   }
+}
 
-  // castling
+void Board::generate_castling_moves(int square, MoveList &moves) const {
+  // castling, the king may not start in, pass through or land in check
+  Side them = (side_to_move == WHITE) ? BLACK : WHITE;
   if (side_to_move == WHITE && square == 4) {
     // white kingside
-    if ((castling_rights & WK) && pieces[5] == EMPTY && pieces[6] == EMPTY) {
-      moves.push_back(Move(4, 6));
+    if ((castling_rights & WK) && pieces[5] == EMPTY && pieces[6] == EMPTY &&
+        !is_square_attacked(4, them) && !is_square_attacked(5, them) &&
+        !is_square_attacked(6, them)) {
+      moves.push_back(Move(4, 6, MOVE_KING_CASTLE));
     }
     // white queenside
     if ((castling_rights & WQ) && pieces[1] == EMPTY && pieces[2] == EMPTY &&
-        pieces[3] == EMPTY) {
-      moves.push_back(Move(4, 2));
+        pieces[3] == EMPTY && !is_square_attacked(4, them) &&
+        !is_square_attacked(3, them) && !is_square_attacked(2, them)) {
+      moves.push_back(Move(4, 2, MOVE_QUEEN_CASTLE));
     }
   } else if (side_to_move == BLACK && square == 60) {
     // black kingside
-    if ((castling_rights & BK) && pieces[61] == EMPTY && pieces[62] == EMPTY) {
-      moves.push_back(Move(60, 62));
+    if ((castling_rights & BK) && pieces[61] == EMPTY && pieces[62] == EMPTY &&
+        !is_square_attacked(60, them) && !is_square_attacked(61, them) &&
+        !is_square_attacked(62, them)) {
+      moves.push_back(Move(60, 62, MOVE_KING_CASTLE));
     }
     // black queenside
     if ((castling_rights & BQ) && pieces[57] == EMPTY && pieces[58] == EMPTY &&
-        pieces[59] == EMPTY) {
-      moves.push_back(Move(60, 58));
+        pieces[59] == EMPTY && !is_square_attacked(60, them) &&
+        !is_square_attacked(59, them) && !is_square_attacked(58, them)) {
+      moves.push_back(Move(60, 58, MOVE_QUEEN_CASTLE));
     }
   }
 }
 
-void Board::generate_sliding_moves(int square, std::vector<Move> &moves) const {
+void Board::generate_sliding_moves(int square, MoveList &moves,
+                                   Bitboard targets) const {
   Piece p = pieces[square];
-
-  int start_dir = 0;
-  int end_dir = 8;
+  Bitboard attacks;
 
   if (p == W_ROOK || p == B_ROOK) {
-    start_dir = 0;
-    end_dir = 4;
+    attacks = rook_attacks(square, occupied);
   } else if (p == W_BISHOP || p == B_BISHOP) {
-    start_dir = 4;
-    end_dir = 8;
+    attacks = bishop_attacks(square, occupied);
+  } else {
+    attacks = queen_attacks(square, occupied);
   }
 
-  constexpr int all_offsets[8] = {-8, -1, 1, 8, -9, -7, 7, 9};
-
-  for (int i = start_dir; i < end_dir; ++i) {
-    int offset = all_offsets[i];
-    int to_square = square;
-
-    while (true) {
-      to_square += offset;
-      if (to_square < 0 || to_square > 63) {
-        break;
-      } // off the board
-
-      int prev_square = to_square - offset;
-      int prev_row = prev_square / 8;
-      int prev_column = prev_square % 8;
-      int to_row = to_square / 8;
-      int to_column = to_square % 8;
-      int row_diff = abs(to_row - prev_row);
-      int column_diff = abs(to_column - prev_column);
-
-      if (offset == -1 || offset == 1) {
-        if (row_diff != 0) {
-          break;
-        }
-      } else if (offset == -8 || offset == 8) {
-        if (column_diff != 0) {
-          break;
-        }
-      } else {
-        if (row_diff != 1 || column_diff != 1) {
-          break;
-        }
-      }
-
-      if (is_our_piece(pieces[to_square])) {
-        break;
-      }
-
-      moves.push_back(Move(square, to_square));
-
-      if (is_opponent_piece(pieces[to_square])) {
-        break;
-      }
-    }
+  targets &= attacks;
+  while (targets) {
+    int to = pop_lsb(targets);
+    moves.push_back(Move(square, to, capture_flag(to)));
   }
 }
 
 int Board::evaluate() const {
-  int score = 0;
-  for (int i = 0; i < 64; ++i) {
-    score += piece_values[pieces[i]];
+  if (nnue_enabled) {
+    int score = nnue_evaluate(accumulator, side_to_move);
+    return side_to_move == WHITE ? score : -score;
+  }
+
+  // pawn structure rarely changes from one node to the next, so it comes
+  // from the cache almost every time
+  PawnEntry pawns =
+      pawn_table ? pawn_table->probe(*this) : evaluate_pawns(*this);
+  int mg = mg_score + pawns.mg + king_shield(*this);
+  int eg = eg_score + pawns.eg;
+
+  // the middlegame and endgame totals are kept as pieces come and go, so
+  // this only blends them by how much material is left. Early promotions can
+  // push phase past MAX_PHASE.
+  int mg_phase = std::min(phase, MAX_PHASE);
+  return (mg * mg_phase + eg * (MAX_PHASE - mg_phase)) / MAX_PHASE;
+}
+
+// castling rights still possible after a move from or to each square: the
+// king squares clear both rights of their side, the rook corners one
+static int castling_mask(int square) {
+  switch (square) {
+  case 0:
+    return ~WQ;
+  case 4:
+    return ~(WK | WQ);
+  case 7:
+    return ~WK;
+  case 56:
+    return ~BQ;
+  case 60:
+    return ~(BK | BQ);
+  case 63:
+    return ~BK;
+  default:
+    return ~0;
   }
-  return score;
 }
 
-BoardState Board::make_move(Move m) {
+void Board::make_move(Move m) {
 
   // state objects to store info to for unmake move function
   BoardState prev_state;
   prev_state.captured_piece = EMPTY;
   prev_state.en_passant_square = en_passant_square;
   prev_state.castling_rights = castling_rights;
+  prev_state.halfmove_clock = halfmove_clock;
+  prev_state.hash_key = hash_key;
 
   // move details
-  int from = m.from;
-  int to = m.to;
-  Piece p = pieces[from];
-  Piece captured = pieces[to];
-
-  pieces[to] = p;
-  pieces[from] = EMPTY;
+  int from = m.from();
+  int to = m.to();
+  int flags = m.flags();
 
-  if (captured != EMPTY) {
-    prev_state.captured_piece = captured;
-  }
+  // captures and pawn moves can't be undone, the clock starts again
+  bool irreversible =
+      m.is_capture() || pieces[from] == W_PAWN || pieces[from] == B_PAWN;
+  halfmove_clock = irreversible ? 0 : halfmove_clock + 1;
 
-  if (m.promotion_piece != EMPTY) {
-    pieces[to] = m.promotion_piece;
+  if (en_passant_square != -1) {
+    hash_key ^= zobrist_en_passant[en_passant_square % 8];
   }
-
   en_passant_square = -1;
 
-  // en passant brh
-  if (p == W_PAWN || p == B_PAWN) {
-    if (to == prev_state.en_passant_square) {
-      // This IS an en passant capture
-      int capture_square;
-      if (side_to_move == WHITE) {
-        capture_square = to - 8; // Black pawn is 1 rank below
-      } else {
-        capture_square = to + 8; // White pawn is 1 rank above
-      }
-      prev_state.captured_piece = pieces[capture_square]; // Store captured pawn
-      pieces[capture_square] = EMPTY;                     // Remove it
-    } else if (std::abs(to - from) == 16) {
-      // This is a double pawn push, set the en passant square
-      if (side_to_move == WHITE) {
-        en_passant_square = from + 8;
-      } else {
-        en_passant_square = from - 8;
-      }
-    }
+  if (flags == MOVE_EN_PASSANT) {
+    // the pawn taken is beside the mover, not on the square it goes to
+    int capture_square = (side_to_move == WHITE) ? to - 8 : to + 8;
+    prev_state.captured_piece = pieces[capture_square];
+    remove_piece(capture_square);
+  } else if (m.is_capture()) {
+    prev_state.captured_piece = pieces[to];
+    remove_piece(to);
   }
-  // i hate en passant
 
-  // castling
-  if ((p == W_KING || p == B_KING) && std::abs(from - to) == 2) {
-    switch (to) {
-    case 6:
-      pieces[5] = pieces[7];
-      pieces[7] = EMPTY;
-      break;
-    case 2:
-      pieces[3] = pieces[0];
-      pieces[0] = EMPTY;
-      break;
-    case 62:
-      pieces[61] = pieces[63];
-      pieces[63] = EMPTY;
-      break;
-    case 58:
-      pieces[59] = pieces[56];
-      pieces[56] = EMPTY;
-      break;
-    }
+  move_piece(from, to);
+
+  if (m.is_promotion()) {
+    remove_piece(to);
+    put_piece(to, m.promotion_piece(side_to_move));
+  } else if (flags == MOVE_DOUBLE_PUSH) {
+    en_passant_square = (from + to) / 2;
+    hash_key ^= zobrist_en_passant[en_passant_square % 8];
+  } else if (flags == MOVE_KING_CASTLE) {
+    move_piece(to + 1, to - 1);
+  } else if (flags == MOVE_QUEEN_CASTLE) {
+    move_piece(to - 2, to + 1);
   }
 
-  // bitwise castlign right check
-  if (p == W_KING) {
-    castling_rights &= ~(WK | WQ);
-  } else if (p == B_KING) {
-    castling_rights &= ~(BK | BQ);
-  } else if (from == 0 || to == 0) { // a1 rook move/capture
-    castling_rights &= ~WQ;
-  } else if (from == 7 || to == 7) { // h1 rook move/capture
-    castling_rights &= ~WK;
-  } else if (from == 56 || to == 56) { // a8 rook move/capture
-    castling_rights &= ~BQ;
-  } else if (from == 63 || to == 63) { // h8 rook move/capture
-    castling_rights &= ~BK;
-  }
-
-  // if rook is captured on the home tile the rights are removed
-  if (captured != EMPTY) {
-    if (to == 0)
-      castling_rights &= ~WQ;
-    else if (to == 7)
-      castling_rights &= ~WK;
-    else if (to == 56)
-      castling_rights &= ~BQ;
-    else if (to == 63)
-      castling_rights &= ~BK;
-  }
+  // moving the king or a rook, or capturing a rook at home, loses rights
+  castling_rights &= castling_mask(from) & castling_mask(to);
+
+  hash_key ^= zobrist_castling[prev_state.castling_rights] ^
+              zobrist_castling[castling_rights];
 
   side_to_move = (side_to_move == WHITE) ? BLACK : WHITE;
+  hash_key ^= zobrist_side;
 
-  return prev_state;
+  history.push_back(prev_state);
 }
 
-void Board::unmake_move(Move m, const BoardState &prev_state) {
-  int from = m.from;
-  int to = m.to;
-  Piece p = pieces[to];
+void Board::unmake_move(Move m) {
+  const BoardState prev_state = history.back();
+  history.pop_back();
+  int from = m.from();
+  int to = m.to();
+  int flags = m.flags();
+
+  // the piece moves below undo their own part of the hash
+  hash_key ^= zobrist_side;
+  hash_key ^= zobrist_castling[castling_rights] ^
+              zobrist_castling[prev_state.castling_rights];
+  if (en_passant_square != -1) {
+    hash_key ^= zobrist_en_passant[en_passant_square % 8];
+  }
+  if (prev_state.en_passant_square != -1) {
+    hash_key ^= zobrist_en_passant[prev_state.en_passant_square % 8];
+  }
 
   side_to_move = (side_to_move == WHITE) ? BLACK : WHITE;
   en_passant_square = prev_state.en_passant_square;
   castling_rights = prev_state.castling_rights;
+  halfmove_clock = prev_state.halfmove_clock;
 
-  if (m.promotion_piece != EMPTY) {
-    p = (side_to_move == WHITE) ? W_PAWN : B_PAWN;
-  }
-
-  pieces[from] = p;
-  pieces[to] = prev_state.captured_piece;
-
-  if ((p == W_PAWN || p == B_PAWN) && to == prev_state.en_passant_square) {
-    pieces[to] = EMPTY;
-    int capture_square;
-    if (side_to_move == WHITE) {
-      capture_square = to - 8;
-    } else {
-      capture_square = to + 8;
-    }
-    pieces[capture_square] = prev_state.captured_piece;
+  if (m.is_promotion()) {
+    remove_piece(to);
+    put_piece(to, (side_to_move == WHITE) ? W_PAWN : B_PAWN);
   }
 
-  if ((p == W_KING || p == B_KING) && std::abs(from - to) == 2) {
-    switch (to) {
-    case 6:
-      pieces[7] = pieces[5];
-      pieces[5] = EMPTY;
-      break;
-    case 2:
-      pieces[0] = pieces[3];
-      pieces[3] = EMPTY;
-      break;
-    case 62:
-      pieces[63] = pieces[61];
-      pieces[61] = EMPTY;
-      break;
-    case 58:
-      pieces[56] = pieces[59];
-      pieces[59] = EMPTY;
-      break;
-    }
+  move_piece(to, from);
+
+  if (flags == MOVE_EN_PASSANT) {
+    int capture_square = (side_to_move == WHITE) ? to - 8 : to + 8;
+    put_piece(capture_square, prev_state.captured_piece);
+  } else if (m.is_capture()) {
+    put_piece(to, prev_state.captured_piece);
+  } else if (flags == MOVE_KING_CASTLE) {
+    move_piece(to - 1, to + 1);
+  } else if (flags == MOVE_QUEEN_CASTLE) {
+    move_piece(to + 1, to - 2);
   }
 }
 
-bool Board::is_square_attacked(int square, Side attacking_side) const {
-  // pawn attacks
-  int dir = (attacking_side == WHITE) ? -1 : 1;
-  Piece attacker_pawn = (attacking_side == WHITE) ? W_PAWN : B_PAWN;
+void Board::make_null_move() {
+  BoardState prev_state;
+  prev_state.captured_piece = EMPTY;
+  prev_state.en_passant_square = en_passant_square;
+  prev_state.castling_rights = castling_rights;
+  prev_state.halfmove_clock = halfmove_clock;
+  prev_state.hash_key = hash_key;
+  history.push_back(prev_state);
 
-  int capture_left = square + (8 * dir) - 1;
-  int capture_right = square + (8 * dir) + 1;
-  int current_col = square % 8;
+  // a position from before the pass with the same side to move would be a
+  // repetition that never happened on the board
+  halfmove_clock = 0;
 
-  if (capture_left >= 0 && capture_left < 64 &&
-      (capture_left % 8) == current_col - 1) {
-    if (pieces[capture_left] == attacker_pawn)
-      return true;
-  }
-  if (capture_right >= 0 && capture_right < 64 &&
-      (capture_right % 8) == current_col + 1) {
-    if (pieces[capture_right] == attacker_pawn)
-      return true;
+  if (en_passant_square != -1) {
+    hash_key ^= zobrist_en_passant[en_passant_square % 8];
   }
+  en_passant_square = -1;
+  side_to_move = (side_to_move == WHITE) ? BLACK : WHITE;
+  hash_key ^= zobrist_side;
+}
 
-  // knight attacks
-  Piece attacker_knight = (attacking_side == WHITE) ? W_KNIGHT : B_KNIGHT;
-  constexpr int knight_offsets[8] = {-17, -15, -10, -6, 6, 10, 15, 17};
-  int from_row = square / 8;
-  int from_col = square % 8;
-
-  for (int offset : knight_offsets) {
-    int to_square = square + offset;
-    if (to_square < 0 || to_square > 63)
-      continue;
-
-    int to_row = to_square / 8;
-    int to_col = to_square % 8;
-    int row_diff = abs(to_row - from_row);
-    int col_diff = abs(to_col - from_col);
-    if (!((row_diff == 2 && col_diff == 1) ||
-          (row_diff == 1 && col_diff == 2))) {
-      continue;
-    }
+void Board::unmake_null_move() {
+  const BoardState &prev_state = history.back();
+  side_to_move = (side_to_move == WHITE) ? BLACK : WHITE;
+  en_passant_square = prev_state.en_passant_square;
+  halfmove_clock = prev_state.halfmove_clock;
+  hash_key = prev_state.hash_key;
+  history.pop_back();
+}
 
-    if (pieces[to_square] == attacker_knight)
+bool Board::is_repetition(int times) const {
+  // positions with the same side to move are 2, 4, 6... plies back, and one
+  // 2 plies back can't be the same (the move there and back takes 4)
+  int size = (int)history.size();
+  int back = std::min(halfmove_clock, size);
+  int seen = 0;
+  for (int i = 4; i <= back; i += 2) {
+    if (history[size - i].hash_key == hash_key && ++seen >= times) {
       return true;
+    }
   }
+  return false;
+}
 
-  // sliding attacks (rook, bishop, queen)
-  Piece attacker_rook = (attacking_side == WHITE) ? W_ROOK : B_ROOK;
-  Piece attacker_bishop = (attacking_side == WHITE) ? W_BISHOP : B_BISHOP;
-  Piece attacker_queen = (attacking_side == WHITE) ? W_QUEEN : B_QUEEN;
-
-  constexpr int all_offsets[8] = {-8, -1, 1, 8, -9, -7, 7, 9};
-
-  for (int i = 0; i < 8; ++i) {
-    int offset = all_offsets[i];
-    int to_square = square;
-
-    while (true) {
-      to_square += offset;
-      if (to_square < 0 || to_square > 63)
-        break;
-
-      int prev_square = to_square - offset;
-      int prev_row = prev_square / 8;
-      int prev_col = prev_square % 8;
-      int to_row = to_square / 8;
-      int to_col = to_square % 8;
-      int row_diff = abs(to_row - prev_row);
-      int col_diff = abs(to_col - prev_col);
-
-      if (offset == -1 || offset == 1) {
-        if (row_diff != 0)
-          break;
-      } else if (offset == -8 || offset == 8) {
-        if (col_diff != 0)
-          break;
-      } else {
-        if (row_diff != 1 || col_diff != 1)
-          break;
-      }
-
-      Piece p_on_square = pieces[to_square];
-
-      if (p_on_square != EMPTY) {
-        if (get_piece_side(p_on_square) == attacking_side) {
-          if (i < 4) {
-            if (p_on_square == attacker_rook || p_on_square == attacker_queen) {
-              return true;
-            }
-          } else {
-            if (p_on_square == attacker_bishop ||
-                p_on_square == attacker_queen) {
-              return true;
-            }
-          }
-        }
-        break;
-      }
+bool Board::is_search_repetition(int ply) const {
+  int size = (int)history.size();
+  int back = std::min(halfmove_clock, size);
+  int seen = 0;
+  for (int i = 4; i <= back; i += 2) {
+    if (history[size - i].hash_key == hash_key && (i < ply || ++seen >= 2)) {
+      return true;
     }
   }
+  return false;
+}
 
-  // king attacks
-  Piece attacker_king = (attacking_side == WHITE) ? W_KING : B_KING;
-  constexpr int king_offsets[8] = {-9, -8, -7, -1, 1, 7, 8, 9};
-  from_row = square / 8;
-  from_col = square % 8;
-
-  for (int offset : king_offsets) {
-    int to_square = square + offset;
-    if (to_square < 0 || to_square > 63)
-      continue;
-
-    int to_row = to_square / 8;
-    int to_col = to_square % 8;
-    int row_diff = abs(to_row - from_row);
-    int col_diff = abs(to_col - from_col);
-    if (row_diff > 1 || col_diff > 1)
-      continue;
-
-    if (pieces[to_square] == attacker_king)
-      return true;
+bool Board::is_fifty_move_draw() const {
+  if (halfmove_clock < FIFTY_MOVE_PLIES) {
+    return false;
+  }
+  if (!is_in_check()) {
+    return true;
   }
+  MoveList moves;
+  generate_legal_moves(moves);
+  return !moves.empty();
+}
+
+bool Board::is_square_attacked(int square, Side attacking_side) const {
+  // every attack is symmetric, so look outwards from the square with each
+  // piece type and see if it lands on an attacker of that type
+  int first = (attacking_side == WHITE) ? W_PAWN : B_PAWN;
+  Side defending_side = (attacking_side == WHITE) ? BLACK : WHITE;
+
+  if (pawn_attacks[defending_side][square] & piece_bb[first + W_PAWN])
+    return true;
+  if (knight_attacks[square] & piece_bb[first + W_KNIGHT])
+    return true;
+  if (king_attacks[square] & piece_bb[first + W_KING])
+    return true;
+
+  Bitboard queens = piece_bb[first + W_QUEEN];
+  if (rook_attacks(square, occupied) & (piece_bb[first + W_ROOK] | queens))
+    return true;
+  if (bishop_attacks(square, occupied) & (piece_bb[first + W_BISHOP] | queens))
+    return true;
 
   return false;
 }
 
+int Board::capture_flag(int to) const {
+  return pieces[to] == EMPTY ? MOVE_QUIET : MOVE_CAPTURE;
+}
+
 bool Board::is_in_check() const {
-  Piece our_king = (side_to_move == WHITE) ? W_KING : B_KING;
   Side opponent_side = (side_to_move == WHITE) ? BLACK : WHITE;
-  int king_square = -1;
-
-  for (int i = 0; i < 64; ++i) {
-    if (pieces[i] == our_king) {
-      king_square = i;
-      break;
-    }
-  }
 
-  if (king_square == -1) {
+  if (king_square[side_to_move] == -1) {
     return false;
   }
 
-  return is_square_attacked(king_square, opponent_side);
+  return is_square_attacked(king_square[side_to_move], opponent_side);
 }
 
-void Board::generate_legal_moves(std::vector<Move> &moves) {
-  std::vector<Move> pseudo_moves;
-  generate_pseudo_legal_moves(pseudo_moves);
-
-  moves.clear();
-
-  for (Move m : pseudo_moves) {
-    BoardState state = make_move(m);
+void Board::generate_legal_moves(MoveList &moves) const {
+  generate_legal(moves, false);
+}
 
-    if (!is_in_check()) {
-      moves.push_back(m);
-    }
+void Board::generate_legal_captures(MoveList &moves) const {
+  generate_legal(moves, true);
+}
 
-    unmake_move(m, state);
-  }
+Bitboard Board::attackers_to(int square, Bitboard occ) const {
+  Bitboard rooks = piece_bb[W_ROOK] | piece_bb[B_ROOK] | piece_bb[W_QUEEN] |
+                   piece_bb[B_QUEEN];
+  Bitboard bishops = piece_bb[W_BISHOP] | piece_bb[B_BISHOP] |
+                     piece_bb[W_QUEEN] | piece_bb[B_QUEEN];
+
+  return (pawn_attacks[BLACK][square] & piece_bb[W_PAWN]) |
+         (pawn_attacks[WHITE][square] & piece_bb[B_PAWN]) |
+         (knight_attacks[square] & (piece_bb[W_KNIGHT] | piece_bb[B_KNIGHT])) |
+         (king_attacks[square] & (piece_bb[W_KING] | piece_bb[B_KING])) |
+         (rook_attacks(square, occ) & rooks) |
+         (bishop_attacks(square, occ) & bishops);
 }
 
-int Board::negamax(int depth, int alpha, int beta) {
-  if (depth == 0) {
-    return evaluate() * (side_to_move == WHITE ? 1 : -1);
+int Board::see(Move m) const {
+  int from = m.from();
+  int to = m.to();
+  Bitboard occ = occupied;
+
+  int gain[32];
+  int d = 0;
+
+  // the piece standing on to, or the pawn taken en passant
+  Piece attacker = pieces[from];
+  if (m.is_en_passant()) {
+    gain[0] = see_values[W_PAWN];
+    occ ^= square_bb(get_piece_side(attacker) == WHITE ? to - 8 : to + 8);
+  } else {
+    gain[0] = see_values[pieces[to] % 6];
   }
 
-  std::vector<Move> moves;
-  generate_legal_moves(moves);
-
-  if (moves.empty()) {
-    if (is_in_check()) {
-      return -(CHECKMATE_SCORE + depth);
-    } else {
-      return 0;
+  Side side = get_piece_side(attacker);
+  Bitboard from_bb = square_bb(from);
+  Bitboard attackers = attackers_to(to, occ);
+  Bitboard rooks = piece_bb[W_ROOK] | piece_bb[B_ROOK] | piece_bb[W_QUEEN] |
+                   piece_bb[B_QUEEN];
+  Bitboard bishops = piece_bb[W_BISHOP] | piece_bb[B_BISHOP] |
+                     piece_bb[W_QUEEN] | piece_bb[B_QUEEN];
+
+  while (from_bb) {
+    // speculatively store what the side to recapture wins if it does
+    ++d;
+    gain[d] = see_values[attacker % 6] - gain[d - 1];
+    if (std::max(-gain[d - 1], gain[d]) < 0 || d == 31) {
+      break;
     }
-  }
 
-  int best_score = -INFINITY_SCORE;
-
-  for (Move m : moves) {
-    BoardState state = make_move(m);
-
-    int score = -negamax(depth - 1, -beta, -alpha);
-
-    unmake_move(m, state);
-
-    best_score = std::max(best_score, score);
-    alpha = std::max(alpha, best_score);
-
-    if (alpha >= beta) {
-      break;
+    // take the attacker off, which may uncover a slider behind it
+    occ ^= from_bb;
+    attackers |= (rook_attacks(to, occ) & rooks) |
+                 (bishop_attacks(to, occ) & bishops);
+    attackers &= occ;
+
+    // least valuable attacker of the side to recapture
+    side = (side == WHITE) ? BLACK : WHITE;
+    from_bb = 0;
+    int first = (side == WHITE) ? W_PAWN : B_PAWN;
+    for (int type = 0; type < 6; ++type) {
+      Bitboard b = attackers & piece_bb[first + type];
+      if (b) {
+        from_bb = b & (0 - b);
+        attacker = (Piece)(first + type);
+        break;
+      }
     }
   }
 
-  return best_score;
+  // each side only carries on capturing while it pays
+  while (--d) {
+    gain[d - 1] = -std::max(-gain[d - 1], gain[d]);
+  }
+  return gain[0];
 }
 
 Move Board::find_best_move(int depth) {
-  std::vector<Move> moves;
-  generate_legal_moves(moves);
-
-  Move best_move;
-  int alpha = -INFINITY_SCORE;
-  int beta = INFINITY_SCORE;
-
-  for (Move m : moves) {
-    BoardState state = make_move(m);
-
-    int score = -negamax(depth - 1, -beta, -alpha);
-
-    unmake_move(m, state);
-
-    if (score > alpha) {
-      alpha = score;
-      best_move = m;
-    }
-  }
-
-  return best_move;
+  SearchLimits limits;
+  limits.depth = depth;
+  return search(*this, limits, tt).best_move;
 }
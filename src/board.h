@@ -1,10 +1,15 @@
 #ifndef BOARD_H
 #define BOARD_H
 
+#include "bitboard.h"
+#include "nnue.h"
+#include <cstdint>
 #include <string>
 #include <vector>
 
 struct Move;
+struct MoveList;
+struct PawnTable;
 
 // 0 to 5 are white, 6-11 are black, 12 is empty space
 enum Piece {
@@ -23,65 +28,188 @@ enum Piece {
   EMPTY
 };
 
+// what make_move can't work out again when the move is taken back, pushed
+// onto Board::history by every move
 struct BoardState {
   Piece captured_piece;
   int en_passant_square;
   int castling_rights;
+  int halfmove_clock;
+  uint64_t hash_key; // of the position before the move
 };
 
 enum Side { WHITE, BLACK };
 
+const std::string START_FEN =
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
 // will use bitwise operator to check if its possible to castle
 constexpr int WK{1};
 constexpr int WQ{2};
 constexpr int BK{4};
 constexpr int BQ{8};
 
+// plies without a capture or pawn move after which the game is drawn
+constexpr int FIFTY_MOVE_PLIES = 100;
+
 struct Board {
   // 64 element array for the board row*8+column
   Piece pieces[64];
 
+  // bitboards kept in sync with pieces, indexed by Piece and by Side
+  Bitboard piece_bb[12];
+  Bitboard side_bb[2];
+  Bitboard occupied;
+
+  // kept up to date by put_piece/remove_piece/move_piece, so nothing has to
+  // scan the board for them
+  int king_square[2]; // -1 if that side has no king
+  int mg_score;       // middlegame piece-square total, white minus black
+  int eg_score;       // endgame piece-square total, white minus black
+  int phase;          // sum of phase_weight, MAX_PHASE at the start
+  Accumulator accumulator; // network first layer, only kept if nnue_enabled
+
   Side side_to_move;
 
   int en_passant_square;
 
   int castling_rights;
 
+  // plies since the last capture or pawn move
+  int halfmove_clock;
+
+  // one entry per move made since the position was set up, the last move's
+  // on top. unmake_move and unmake_null_move take theirs back off.
+  std::vector<BoardState> history;
+
+  // zobrist key of the position, kept up to date by make_move/unmake_move
+  uint64_t hash_key;
+
+  // the same, from the pawns alone, for caching pawn structure scores
+  uint64_t pawn_key;
+
+  // where evaluate() caches pawn structure, set by whoever owns the board
+  // (a search thread). Without one it is worked out every time.
+  PawnTable *pawn_table = nullptr;
+
   // Constructor to initalize the baord to the correct starting position
   Board();
 
+  // Load a position from FEN, returns false (and leaves the board as it
+  // was) if the string is malformed, has a pawn on the first or last rank,
+  // or the side not to move is in check. Castling rights whose king or rook
+  // has left its home square are dropped, and so is an en passant square
+  // without a pawn that could just have passed it. The halfmove clock is
+  // optional, the fullmove number is accepted but not tracked. The history
+  // starts empty.
+  bool set_fen(const std::string &fen);
+
+  // The position as FEN. The fullmove number isn't tracked, so it always
+  // comes out as 1.
+  std::string to_fen() const;
+
+  // Sets up count pieces, list[i] on squares[i], with side to move and no
+  // castling or en passant. Nothing is checked, the caller makes sure there
+  // are two kings and no square is used twice. For building positions in
+  // bulk (tablebase generation) without going through FEN.
+  void set_pieces(const Piece list[], const int squares[], int count,
+                  Side side);
+
   // Print the board
   void print_board();
-  void generate_pseudo_legal_moves(std::vector<Move> &moves) const;
+  void generate_pseudo_legal_moves(MoveList &moves) const;
+  // only captures (en passant included) and promotions, for quiescence
+  void generate_pseudo_legal_captures(MoveList &moves) const;
 
   Side get_piece_side(Piece p) const;
 
   int evaluate() const;
 
+  // single threaded fixed depth search against the shared table, see
+  // search() in search.h for the full interface
   Move find_best_move(int depth);
 
-  BoardState make_move(Move m);
-  void unmake_move(Move m, const BoardState &prev_state);
+  // unmake_move takes back the last move made, which has to be m
+  void make_move(Move m);
+  void unmake_move(Move m);
+
+  // Passes the turn, for null move pruning. Not for use in check, where the
+  // result wouldn't be a legal position. Repetitions aren't looked for
+  // across it.
+  void make_null_move();
+  void unmake_null_move();
+
+  // The position has been on the board at least times times before, with
+  // the same side to move. Only looks back as far as the last capture, pawn
+  // move or null move, since nothing before one of those can come back.
+  bool is_repetition(int times) const;
+
+  // A repetition the search scores as a draw, ply plies below its root: the
+  // position came up once since the root (a cycle the search would only go
+  // round again), or twice in the game before it, so that with this one it
+  // is a threefold repetition.
+  bool is_search_repetition(int ply) const;
+
+  // a hundred plies without a capture or pawn move, unless the move that
+  // got there mated
+  bool is_fifty_move_draw() const;
 
   bool is_in_check() const;
 
-  void generate_legal_moves(std::vector<Move> &moves);
+  // hash of the position built from scratch, hash_key should always match it
+  uint64_t compute_hash() const;
+
+  // only legal moves, using pin and check masks rather than trying each
+  // move on the board
+  void generate_legal_moves(MoveList &moves) const;
+  void generate_legal_captures(MoveList &moves) const;
+
+  // pieces of both sides attacking square, given occupancy occ
+  Bitboard attackers_to(int square, Bitboard occ) const;
+
+  // Static exchange evaluation: material won or lost (centipawns) by the
+  // capture m once every recapture on the square is played out in least
+  // valuable attacker order
+  int see(Move m) const;
 
 private: // encapsulated function for moves
-  void generate_pawn_moves(int square, std::vector<Move> &moves) const;
-  void generate_knight_moves(int square, std::vector<Move> &moves) const;
-  void generate_king_moves(int square, std::vector<Move> &moves) const;
-  void generate_sliding_moves(int square, std::vector<Move> &moves)
+  void generate_moves(MoveList &moves, bool captures_only) const;
+  void generate_legal(MoveList &moves, bool captures_only) const;
+
+  // mask limits where the pawn may land, for check and pin restrictions
+  void generate_pawn_moves(int square, MoveList &moves, bool captures_only,
+                           Bitboard mask) const;
+  void generate_knight_moves(int square, MoveList &moves,
+                             Bitboard targets) const;
+  void generate_king_moves(int square, MoveList &moves,
+                           bool captures_only) const;
+  void generate_castling_moves(int square, MoveList &moves) const;
+  void generate_sliding_moves(int square, MoveList &moves, Bitboard targets)
       const; // works for rook, bishop, queen
   void add_pawn_move(int from, int to,
-                     std::vector<Move> &moves) const; // for promotion
+                     MoveList &moves) const; // for promotion
+
+  // MOVE_CAPTURE if a piece stands on to, MOVE_QUIET otherwise
+  int capture_flag(int to) const;
+
+  // squares a piece may move to: empty or enemy, or only enemy
+  Bitboard move_targets(bool captures_only) const;
 
-  bool is_our_piece(Piece p) const;
-  bool is_opponent_piece(Piece p) const;
+  // our pieces that are the only thing between our king and an enemy slider
+  Bitboard pinned_pieces(int king_sq) const;
+
+  // en passant can expose the king along the rank both pawns leave
+  bool en_passant_is_legal(int from) const;
 
   bool is_square_attacked(int square, Side attacking_side) const;
 
-  int negamax(int depth, int alpha, int beta);
+  // empty board, no castling rights, white to move
+  void clear();
+
+  // keep pieces and the bitboards in sync
+  void put_piece(int square, Piece p);
+  void remove_piece(int square);
+  void move_piece(int from, int to);
 };
 
 #endif
@@ -0,0 +1,237 @@
+#include "book.h"
+#include "zobrist.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+Book book;
+
+uint64_t polyglot_key(const Board &board) {
+  uint64_t key = 0;
+
+  for (int p = 0; p < 12; ++p) {
+    // polyglot interleaves the colours: black pawn, white pawn, black knight
+    int type = p % 6;
+    int kind = 2 * type + (p < 6 ? 1 : 0);
+    Bitboard b = board.piece_bb[p];
+    while (b) {
+      key ^= polyglot_random[64 * kind + pop_lsb(b)];
+    }
+  }
+
+  constexpr int castling_flags[4] = {WK, WQ, BK, BQ};
+  for (int i = 0; i < 4; ++i) {
+    if (board.castling_rights & castling_flags[i]) {
+      key ^= polyglot_random[POLYGLOT_CASTLING + i];
+    }
+  }
+
+  int ep = board.en_passant_square;
+  if (ep != -1) {
+    Side us = board.side_to_move;
+    Side them = us == WHITE ? BLACK : WHITE;
+    Piece our_pawn = us == WHITE ? W_PAWN : B_PAWN;
+    // the squares a pawn of ours could take from are the ones an enemy pawn
+    // on the target square would attack
+    if (pawn_attacks[them][ep] & board.piece_bb[our_pawn]) {
+      key ^= polyglot_random[POLYGLOT_EN_PASSANT + ep % 8];
+    }
+  }
+
+  if (board.side_to_move == WHITE) {
+    key ^= polyglot_random[POLYGLOT_TURN];
+  }
+  return key;
+}
+
+static uint64_t read_big_endian(const unsigned char *p, int bytes) {
+  uint64_t value = 0;
+  for (int i = 0; i < bytes; ++i) {
+    value = (value << 8) | p[i];
+  }
+  return value;
+}
+
+uint16_t encode_book_move(Move move) {
+  int from = move.from();
+  int to = move.to();
+  // castling goes down as the king taking its own rook
+  if (move.flags() == MOVE_KING_CASTLE) {
+    to = from + 3;
+  } else if (move.flags() == MOVE_QUEEN_CASTLE) {
+    to = from - 4;
+  }
+  // knight to queen are types 1-4, the same numbers polyglot uses
+  int promotion = move.is_promotion() ? move.promotion_piece(WHITE) : 0;
+  return (uint16_t)(to | from << 6 | promotion << 12);
+}
+
+static void write_big_endian(unsigned char *p, uint64_t value, int bytes) {
+  for (int i = bytes - 1; i >= 0; --i) {
+    p[i] = (unsigned char)(value & 0xFF);
+    value >>= 8;
+  }
+}
+
+bool write_book(const std::string &path, std::vector<BookEntry> &entries) {
+  std::sort(entries.begin(), entries.end(),
+            [](const BookEntry &a, const BookEntry &b) {
+              if (a.key != b.key) {
+                return a.key < b.key;
+              }
+              // the move only breaks ties, so the same input always gives
+              // the same file
+              return a.weight != b.weight ? a.weight > b.weight
+                                          : a.move < b.move;
+            });
+
+  FILE *file = std::fopen(path.c_str(), "wb");
+  if (!file) {
+    return false;
+  }
+  bool ok = true;
+  for (const BookEntry &e : entries) {
+    unsigned char record[BOOK_ENTRY_SIZE];
+    write_big_endian(record, e.key, 8);
+    write_big_endian(record + 8, e.move, 2);
+    write_big_endian(record + 10, e.weight, 2);
+    write_big_endian(record + 12, e.learn, 4);
+    ok = ok && std::fwrite(record, BOOK_ENTRY_SIZE, 1, file) == 1;
+  }
+  return std::fclose(file) == 0 && ok;
+}
+
+bool Book::open(const std::string &path) {
+  close();
+
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size == 0 ||
+      st.st_size % BOOK_ENTRY_SIZE != 0) {
+    ::close(fd);
+    return false;
+  }
+
+  void *mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  // the mapping keeps the file alive, the descriptor isn't needed any more
+  ::close(fd);
+  if (mapped == MAP_FAILED) {
+    return false;
+  }
+
+  data = (const unsigned char *)mapped;
+  map_size = st.st_size;
+  entry_count = map_size / BOOK_ENTRY_SIZE;
+  return true;
+}
+
+void Book::close() {
+  if (data) {
+    munmap((void *)data, map_size);
+  }
+  data = nullptr;
+  map_size = entry_count = 0;
+}
+
+BookEntry Book::entry(size_t index) const {
+  const unsigned char *p = data + index * BOOK_ENTRY_SIZE;
+  BookEntry e;
+  e.key = read_big_endian(p, 8);
+  e.move = (uint16_t)read_big_endian(p + 8, 2);
+  e.weight = (uint16_t)read_big_endian(p + 10, 2);
+  e.learn = (uint32_t)read_big_endian(p + 12, 4);
+  return e;
+}
+
+// Polyglot moves are from/to squares with files and rows in 3 bits each,
+// plus a promotion piece (none, n, b, r, q). Castling is written as the
+// king taking its own rook.
+static Move decode_move(const Board &board, uint16_t move) {
+  int to = move & 63;
+  int from = (move >> 6) & 63;
+  int promotion = (move >> 12) & 7;
+
+  Piece p = board.pieces[from];
+  if (p == W_KING && from == 4) {
+    to = to == 7 ? 6 : (to == 0 ? 2 : to);
+  } else if (p == B_KING && from == 60) {
+    to = to == 63 ? 62 : (to == 56 ? 58 : to);
+  }
+
+  std::string str = move_to_string(Move(from, to));
+  if (promotion > 0) {
+    str += " nbrq"[promotion];
+  }
+  return parse_move(board, str);
+}
+
+Move Book::probe(const Board &board) const {
+  if (!data) {
+    return Move();
+  }
+
+  // first entry with this key, the entries are sorted by key
+  uint64_t key = polyglot_key(board);
+  size_t low = 0, high = entry_count;
+  while (low < high) {
+    size_t mid = low + (high - low) / 2;
+    if (entry(mid).key < key) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+
+  // keep the legal ones, a hash collision could give moves from elsewhere
+  std::vector<BookEntry> candidates;
+  std::vector<Move> moves;
+  uint32_t total_weight = 0;
+  for (size_t i = low; i < entry_count; ++i) {
+    BookEntry e = entry(i);
+    if (e.key != key) {
+      break;
+    }
+    Move m = decode_move(board, e.move);
+    if (m.is_none()) {
+      continue;
+    }
+    candidates.push_back(e);
+    moves.push_back(m);
+    total_weight += e.weight;
+  }
+  if (moves.empty()) {
+    return Move();
+  }
+
+  if (best_move_only || total_weight == 0) {
+    size_t best = 0;
+    for (size_t i = 1; i < candidates.size(); ++i) {
+      if (candidates[i].weight > candidates[best].weight) {
+        best = i;
+      }
+    }
+    return moves[best];
+  }
+
+  // weighted choice, seeded from the clock so games vary
+  uint64_t state =
+      std::chrono::steady_clock::now().time_since_epoch().count() | 1;
+  uint32_t pick = random_u64(state) % total_weight;
+  for (size_t i = 0; i < candidates.size(); ++i) {
+    if (pick < candidates[i].weight) {
+      return moves[i];
+    }
+    pick -= candidates[i].weight;
+  }
+  return moves.back();
+}
@@ -0,0 +1,63 @@
+#ifndef BOOK_H
+#define BOOK_H
+
+#include "board.h"
+#include "move.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// one 16 byte record of a Polyglot .bin file, stored big endian and sorted
+// by key
+struct BookEntry {
+  uint64_t key;
+  uint16_t move;
+  uint16_t weight;
+  uint32_t learn;
+};
+
+constexpr size_t BOOK_ENTRY_SIZE = 16;
+
+// Polyglot hash of the position. Unlike Board::hash_key the en passant file
+// only counts when a pawn of the side to move can actually take.
+uint64_t polyglot_key(const Board &board);
+
+// The Polyglot encoding of a legal move
+uint16_t encode_book_move(Move move);
+
+// Sorts entries by key, best weight first within a key, and writes them as
+// a Polyglot file. Returns false if the file can't be written.
+bool write_book(const std::string &path, std::vector<BookEntry> &entries);
+
+// A Polyglot opening book, mapped read only so every engine process using
+// the same file shares one copy in the page cache
+struct Book {
+  const unsigned char *data = nullptr;
+  size_t map_size = 0;
+  size_t entry_count = 0;
+
+  // play the highest weighted move instead of picking by weight at random
+  bool best_move_only = false;
+
+  Book() = default;
+  Book(const Book &) = delete;
+  Book &operator=(const Book &) = delete;
+  ~Book() { close(); }
+
+  // Maps the file, returns false (leaving no book open) if it can't be
+  // opened or isn't a whole number of entries
+  bool open(const std::string &path);
+  void close();
+  bool is_open() const { return data != nullptr; }
+
+  BookEntry entry(size_t index) const;
+
+  // A legal book move for the position, or the null move if the book has
+  // none
+  Move probe(const Board &board) const;
+};
+
+extern Book book;
+
+#endif
@@ -0,0 +1,197 @@
+#include "epd.h"
+#include "board.h"
+#include "move.h"
+#include "search.h"
+#include "tt.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using std::cout;
+
+constexpr int EPD_DEFAULT_DEPTH = 8;
+constexpr size_t EPD_DEFAULT_HASH_MB = 16; // per worker
+
+// shared between the workers: the input, the output, and the totals
+struct EpdBatch {
+  std::istream *in;
+  std::mutex in_mutex;
+  std::mutex out_mutex;
+
+  SearchLimits limits;
+
+  uint64_t positions = 0;
+  uint64_t nodes = 0;
+  uint64_t skipped = 0;
+
+  // next line worth analysing, false at the end of the input
+  bool next_line(std::string &line) {
+    std::lock_guard<std::mutex> lock(in_mutex);
+    while (std::getline(*in, line)) {
+      if (!line.empty() && line.back() == '\r') {
+        line.pop_back();
+      }
+      bool blank = line.find_first_not_of(" \t") == std::string::npos;
+      if (!blank && line[0] != '#') {
+        return true;
+      }
+    }
+    return false;
+  }
+};
+
+// the EPD operations after the position ("bm e4; id \"x\";"), with the move
+// clocks of a FEN line dropped
+static std::string epd_operations(const std::string &line) {
+  std::istringstream in(line);
+  std::string field;
+  for (int i = 0; i < 4; ++i) {
+    in >> field;
+  }
+
+  std::string rest;
+  std::getline(in, rest);
+  std::istringstream clocks(rest);
+  int halfmove, fullmove;
+  if (clocks >> halfmove >> fullmove) {
+    std::string after_clocks;
+    std::getline(clocks, after_clocks);
+    rest = after_clocks;
+  }
+
+  size_t start = rest.find_first_not_of(' ');
+  return start == std::string::npos ? "" : rest.substr(start);
+}
+
+// "ce" in mate scores follows the EPD convention of 32767 - plies to mate
+static int epd_score(int score) {
+  if (score > MATE_BOUND) {
+    return 32767 - (CHECKMATE_SCORE - score);
+  }
+  if (score < -MATE_BOUND) {
+    return -32767 + (CHECKMATE_SCORE + score);
+  }
+  return score;
+}
+
+std::string epd_result_line(const Board &board, const std::string &line,
+                            const SearchResult &result) {
+  // the position part of the FEN, without the move clocks
+  std::string fen = board.to_fen();
+  fen.erase(fen.rfind(' ', fen.rfind(' ') - 1));
+
+  // a mated or stalemated position has no move to predict, only its score
+  std::ostringstream out;
+  out << fen;
+  if (!result.best_move.is_none()) {
+    out << " pm " << move_to_string(result.best_move) << ';';
+  }
+  out << " ce " << epd_score(result.score) << "; acd " << result.depth
+      << "; acn " << result.nodes << "; acs " << result.seconds << ';';
+  std::string operations = epd_operations(line);
+  if (!operations.empty()) {
+    out << ' ' << operations;
+  }
+  return out.str();
+}
+
+static void epd_worker(EpdBatch &batch, size_t hash_mb) {
+  TranspositionTable table;
+  table.resize(hash_mb);
+
+  std::string line;
+  Board board;
+  while (batch.next_line(line)) {
+    if (!board.set_fen(line)) {
+      std::lock_guard<std::mutex> lock(batch.out_mutex);
+      std::cerr << "Skipping invalid position: " << line << '\n';
+      ++batch.skipped;
+      continue;
+    }
+
+    // every position starts from an empty table so results don't depend on
+    // which worker got which line
+    table.clear();
+    SearchResult result = search(board, batch.limits, table);
+    std::string out = epd_result_line(board, line, result);
+
+    std::lock_guard<std::mutex> lock(batch.out_mutex);
+    cout << out << '\n';
+    if (stats_enabled) {
+      std::cerr << search_stats_json(result) << '\n';
+    }
+    ++batch.positions;
+    batch.nodes += result.nodes;
+  }
+}
+
+int epd_command(int argc, char *argv[]) {
+  EpdBatch batch;
+  batch.limits.depth = EPD_DEFAULT_DEPTH;
+  int threads = 1;
+  size_t hash_mb = EPD_DEFAULT_HASH_MB;
+  std::string path;
+
+  for (int i = 0; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--depth" && i + 1 < argc) {
+      batch.limits.depth =
+          std::max(1, std::min(std::atoi(argv[++i]), MAX_PLY - 1));
+    } else if (arg == "--nodes" && i + 1 < argc) {
+      // a node budget replaces the default depth
+      batch.limits.nodes = std::strtoull(argv[++i], nullptr, 10);
+      batch.limits.depth = MAX_PLY - 1;
+    } else if (arg == "--threads" && i + 1 < argc) {
+      threads = std::max(1, std::atoi(argv[++i]));
+    } else if (arg == "--hash" && i + 1 < argc) {
+      hash_mb = std::max<size_t>(1, std::strtoul(argv[++i], nullptr, 10));
+    } else if (path.empty() && arg[0] != '-') {
+      path = arg;
+    } else if (arg != "-") {
+      cout << "usage: chess_engine epd [--depth n | --nodes n] [--threads n] "
+              "[--hash mb] [file]\n";
+      return 1;
+    }
+  }
+
+  std::ifstream file;
+  if (path.empty()) {
+    batch.in = &std::cin;
+  } else {
+    file.open(path);
+    if (!file) {
+      cout << "Could not open " << path << '\n';
+      return 1;
+    }
+    batch.in = &file;
+  }
+
+  // one search thread per position, the pool spreads positions over cores
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> workers;
+  for (int i = 0; i < threads; ++i) {
+    workers.emplace_back(epd_worker, std::ref(batch), hash_mb);
+  }
+  for (std::thread &w : workers) {
+    w.join();
+  }
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+
+  // the summary goes to stderr so stdout stays one line per position
+  std::cerr << "Positions: " << batch.positions << " (" << batch.skipped
+            << " skipped)\n"
+            << "Nodes: " << batch.nodes << '\n'
+            << "Time: " << (int)(seconds * 1000) << " ms\n"
+            << "NPS: " << (uint64_t)(batch.nodes / std::max(seconds, 0.001))
+            << '\n';
+  return 0;
+}
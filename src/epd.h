@@ -0,0 +1,22 @@
+#ifndef EPD_H
+#define EPD_H
+
+#include "board.h"
+#include "search.h"
+#include <string>
+
+// Entry point for "chess_engine epd ...": analyses every EPD/FEN line of a
+// file (or stdin) on a pool of threads and writes one result line per
+// position as it finishes. Lines are read as workers become free, so memory
+// use does not depend on the size of the input. Returns the process exit
+// code.
+int epd_command(int argc, char *argv[]);
+
+// The output line for one analysed input line: the position, "pm" with the
+// best move, "ce" (mate scores as 32767 - plies to mate), "acd", "acn",
+// "acs", then the operations the input line already had. A mated or
+// stalemated position gets no "pm", only its score at depth 0.
+std::string epd_result_line(const Board &board, const std::string &line,
+                            const SearchResult &result);
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef EVAL_H
+#define EVAL_H
+
+// Piece-square tables with the piece value folded in, for every Piece
+// (black entries are mirrored and negated) so Board can keep running
+// middlegame and endgame totals from white's point of view
+extern int mg_table[12][64];
+extern int eg_table[12][64];
+
+// how much each piece counts towards the game phase, 24 with every piece on
+// the board, 0 with only kings and pawns
+constexpr int phase_weight[12] = {0, 1, 1, 2, 4, 0, 0, 1, 1, 2, 4, 0};
+constexpr int MAX_PHASE = 24;
+
+// Fills the tables, only does the work the first time it is called
+void init_eval();
+
+#endif
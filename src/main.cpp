@@ -1,98 +1,173 @@
+#include "bench.h"
+#include "book.h"
 #include "board.h"
+#include "epd.h"
+#include "makebook.h"
+#include "match.h"
 #include "move.h"
+#include "nnue.h"
+#include "perft.h"
+#include "search.h"
+#include "selftest.h"
+#include "tablebase.h"
+#include "tt.h"
+#include "uci.h"
+#include <algorithm>
+#include <cstdlib>
 #include <iostream>
 #include <string>
-#include <vector>
 
 using std::cout;
 
-Move parse_move(Board &board, std::string move_str) {
-  std::vector<Move> legal_moves;
-  board.generate_legal_moves(legal_moves);
+// how long the computer thinks per move unless told otherwise
+constexpr int64_t AI_MOVE_TIME_MS = 2000;
 
-  int from_col = move_str[0] - 'a';
-  int from_row = move_str[1] - '1';
-  int to_col = move_str[2] - 'a';
-  int to_row = move_str[3] - '1';
-
-  int from_sq = from_row * 8 + from_col;
-  int to_sq = to_row * 8 + to_col;
-
-  Piece promotion_p = EMPTY;
-  if (move_str.length() == 5) {
-    switch (move_str[4]) {
-    case 'q':
-      promotion_p = (board.side_to_move == WHITE) ? W_QUEEN : B_QUEEN;
-      break;
-    case 'r':
-      promotion_p = (board.side_to_move == WHITE) ? W_ROOK : B_ROOK;
-      break;
-    case 'b':
-      promotion_p = (board.side_to_move == WHITE) ? W_BISHOP : B_BISHOP;
-      break;
-    case 'n':
-      promotion_p = (board.side_to_move == WHITE) ? W_KNIGHT : B_KNIGHT;
-      break;
-    }
+int main(int argc, char *argv[]) {
+  if (argc >= 2 && std::string(argv[1]) == "perft") {
+    return perft_command(argc - 2, argv + 2);
+  }
+  if (argc >= 2 && std::string(argv[1]) == "bench") {
+    return bench_command(argc - 2, argv + 2);
+  }
+  if (argc >= 2 && std::string(argv[1]) == "epd") {
+    return epd_command(argc - 2, argv + 2);
+  }
+  if (argc >= 2 && std::string(argv[1]) == "makebook") {
+    return makebook_command(argc - 2, argv + 2);
+  }
+  if (argc >= 2 && std::string(argv[1]) == "gentb") {
+    return gentb_command(argc - 2, argv + 2);
+  }
+  if (argc >= 2 && std::string(argv[1]) == "match") {
+    return match_command(argc - 2, argv + 2);
+  }
+  if (argc >= 2 && std::string(argv[1]) == "selftest") {
+    return selftest_command(argc - 2, argv + 2);
   }
 
-  for (const Move &m : legal_moves) {
-    if (m.from == from_sq && m.to == to_sq) {
-      if (m.promotion_piece != EMPTY) {
-        if (m.promotion_piece == promotion_p) {
-          return m;
-        }
-      } else {
-        return m;
+  // --hash <mb> sets the transposition table size
+  // --threads <n> sets how many threads search in parallel
+  // --movetime <ms> sets how long the computer thinks per move
+  // --depth <n> searches to a fixed depth instead, with no time limit
+  // --nnue <file> evaluates with the network in file
+  // --book <file> plays from a Polyglot opening book while it has moves
+  // --book-mode best|weighted picks the top book move or one by weight
+  // --tb <dir> plays endgames perfectly from the tables gentb wrote to dir
+  size_t hash_mb = DEFAULT_HASH_MB;
+  int threads = 1;
+  int64_t move_time_ms = AI_MOVE_TIME_MS;
+  int fixed_depth = 0;
+  for (int i = 1; i + 1 < argc; ++i) {
+    if (std::string(argv[i]) == "--hash") {
+      hash_mb = std::strtoul(argv[i + 1], nullptr, 10);
+    } else if (std::string(argv[i]) == "--threads") {
+      threads = std::max(1, std::atoi(argv[i + 1]));
+    } else if (std::string(argv[i]) == "--movetime") {
+      move_time_ms = std::max<int64_t>(1, std::atoll(argv[i + 1]));
+    } else if (std::string(argv[i]) == "--depth") {
+      fixed_depth = std::max(1, std::atoi(argv[i + 1]));
+    } else if (std::string(argv[i]) == "--book") {
+      if (!book.open(argv[i + 1])) {
+        std::cout << "Could not open book " << argv[i + 1] << '\n';
+      }
+    } else if (std::string(argv[i]) == "--book-mode") {
+      book.best_move_only = std::string(argv[i + 1]) == "best";
+    } else if (std::string(argv[i]) == "--tb") {
+      if (tb_init(argv[i + 1]) == 0) {
+        std::cout << "No tablebases found in " << argv[i + 1] << '\n';
+      }
+    } else if (std::string(argv[i]) == "--nnue") {
+      if (!nnue_load(argv[i + 1])) {
+        std::cout << "Could not load network " << argv[i + 1]
+                  << ", using the classical evaluation\n";
       }
     }
   }
+  tt.resize(hash_mb);
 
-  return Move(-1, -1);
-}
+  // "chess_engine uci", or a GUI that starts the engine and says "uci"
+  // instead of playing a move
+  if (argc >= 2 && std::string(argv[1]) == "uci") {
+    return uci_loop(threads);
+  }
 
-int main() {
   Board board;
   std::string move_str;
 
-  constexpr int AI_SEARCH_DEPTH = 5;
-
   while (true) {
     board.print_board();
 
-    std::vector<Move> legal_moves;
-    board.generate_legal_moves(legal_moves);
-
-    if (legal_moves.empty()) {
-      if (board.is_in_check()) {
-        std::cout << "Checkmate! "
-                  << (board.side_to_move == WHITE ? "Black" : "White")
-                  << " wins.\n";
-      } else {
-        std::cout << "Stalemate! It's a draw.\n";
-      }
+    GameResult state = game_result(board);
+    if (state == GAME_CHECKMATE) {
+      std::cout << "Checkmate! "
+                << (board.side_to_move == WHITE ? "Black" : "White")
+                << " wins.\n";
+      break;
+    }
+    if (state == GAME_STALEMATE) {
+      std::cout << "Stalemate! It's a draw.\n";
+      break;
+    }
+    if (state == GAME_REPETITION) {
+      std::cout << "Threefold repetition! It's a draw.\n";
+      break;
+    }
+    if (state == GAME_FIFTY_MOVES) {
+      std::cout << "Fifty moves without a capture or pawn move! It's a "
+                   "draw.\n";
+      break;
+    }
+    if (state == GAME_INSUFFICIENT_MATERIAL) {
+      std::cout << "Neither side can mate! It's a draw.\n";
       break;
     }
 
     if (board.side_to_move == WHITE) {
       std::cout << "Enter your move (e.g., e2e4): ";
-      std::cin >> move_str;
+      if (!(std::cin >> move_str)) {
+        break;
+      }
+      if (move_str == "uci") {
+        return uci_loop(threads, move_str);
+      }
 
       Move user_move = parse_move(board, move_str);
 
-      if (user_move.from == -1) {
+      if (user_move.is_none()) {
         std::cout << "Invalid or illegal move. Try again.\n";
         continue;
       }
 
       board.make_move(user_move);
     } else {
-      std::cout << "\nComputer is thinking at depth " << AI_SEARCH_DEPTH
-                << "...\n";
+      // known openings need no thinking
+      Move book_move = book.probe(board);
+      if (!book_move.is_none()) {
+        std::cout << "\nComputer plays: " << move_to_string(book_move)
+                  << " (book)\n";
+        board.make_move(book_move);
+        continue;
+      }
+
+      SearchLimits limits;
+      if (fixed_depth > 0) {
+        std::cout << "\nComputer is thinking at depth " << fixed_depth
+                  << "...\n";
+        limits.depth = fixed_depth;
+      } else {
+        std::cout << "\nComputer is thinking for " << move_time_ms
+                  << " ms...\n";
+        limits = time_limits(move_time_ms);
+      }
+      limits.threads = threads;
 
-      Move ai_move = board.find_best_move(AI_SEARCH_DEPTH);
+      SearchResult result = search(board, limits, tt);
+      Move ai_move = result.best_move;
 
-      std::cout << "Computer plays: " << move_to_string(ai_move) << "\n";
+      std::cout << "Computer plays: " << move_to_string(ai_move) << " (depth "
+                << result.depth << ", " << result.nodes << " nodes, "
+                << (uint64_t)(result.nodes / std::max(result.seconds, 0.001))
+                << " nps, " << threads << " threads)\n";
 
       board.make_move(ai_move);
     }
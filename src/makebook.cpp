@@ -0,0 +1,448 @@
+#include "makebook.h"
+#include "board.h"
+#include "book.h"
+#include "move.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+using std::cout;
+
+constexpr int DEFAULT_BOOK_PLIES = 24;
+
+// files are cut into pieces of about this size, small enough that every
+// thread gets several and a slow piece doesn't leave the others idle
+constexpr size_t CHUNK_BYTES = 8 << 20;
+
+// the statistics are spread over this many maps, each with its own lock
+constexpr int SHARD_COUNT = 256;
+
+// a worker hands its counts over once it has this many
+constexpr size_t FLUSH_RECORDS = 16384;
+
+// a PGN file mapped read only
+struct MappedFile {
+  const char *data = nullptr;
+  size_t size = 0;
+
+  MappedFile() = default;
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+  ~MappedFile() {
+    if (data) {
+      munmap((void *)data, size);
+    }
+  }
+
+  bool open(const std::string &path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+      ::close(fd);
+      return false;
+    }
+    void *mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED) {
+      return false;
+    }
+    // the file is read front to back once
+    madvise(mapped, st.st_size, MADV_SEQUENTIAL);
+    data = (const char *)mapped;
+    size = st.st_size;
+    return true;
+  }
+};
+
+// a piece of one file that starts at a game and ends where the next piece
+// starts
+struct Chunk {
+  const char *begin;
+  const char *end;
+};
+
+// one move played from one position, and how it went
+struct BookRecord {
+  uint64_t key;
+  uint16_t move;
+  uint32_t games;
+  uint32_t points; // 2 per win and 1 per draw for the side that moved
+};
+
+struct BookKey {
+  uint64_t key;
+  uint16_t move;
+  bool operator==(const BookKey &other) const {
+    return key == other.key && move == other.move;
+  }
+};
+
+struct BookKeyHash {
+  size_t operator()(const BookKey &k) const {
+    return k.key ^ (k.move * 0x9E3779B97F4A7C15ULL);
+  }
+};
+
+struct BookStats {
+  uint32_t games = 0;
+  uint32_t points = 0;
+};
+
+struct Shard {
+  std::mutex mutex;
+  std::unordered_map<BookKey, BookStats, BookKeyHash> stats;
+};
+
+// shared by the workers
+struct BookBuilder {
+  std::vector<Chunk> chunks;
+  std::atomic<size_t> next_chunk{0};
+  Shard shards[SHARD_COUNT];
+  int max_plies = DEFAULT_BOOK_PLIES;
+
+  std::atomic<uint64_t> games{0};
+  std::atomic<uint64_t> bad_games{0};
+  std::atomic<uint64_t> positions{0};
+};
+
+static int shard_of(uint64_t key) { return (int)(key >> 56); }
+
+// merges a worker's records into the shards, one lock per shard touched
+static void flush(BookBuilder &builder, std::vector<BookRecord> &records) {
+  std::sort(records.begin(), records.end(),
+            [](const BookRecord &a, const BookRecord &b) {
+              return shard_of(a.key) < shard_of(b.key);
+            });
+  size_t i = 0;
+  while (i < records.size()) {
+    Shard &shard = builder.shards[shard_of(records[i].key)];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    int index = shard_of(records[i].key);
+    for (; i < records.size() && shard_of(records[i].key) == index; ++i) {
+      BookStats &s = shard.stats[BookKey{records[i].key, records[i].move}];
+      s.games += records[i].games;
+      s.points += records[i].points;
+    }
+  }
+  records.clear();
+}
+
+// where the game starting at or after p begins: the first "[Event " at the
+// start of a line
+static const char *next_game(const char *p, const char *begin,
+                             const char *end) {
+  static const char tag[] = "[Event ";
+  const size_t tag_length = sizeof(tag) - 1;
+  while (p < end) {
+    const char *found =
+        (const char *)memmem(p, end - p, tag, tag_length);
+    if (!found) {
+      return end;
+    }
+    if (found == begin || found[-1] == '\n') {
+      return found;
+    }
+    p = found + 1;
+  }
+  return end;
+}
+
+static void split_into_chunks(const MappedFile &file,
+                              std::vector<Chunk> &chunks) {
+  const char *begin = file.data;
+  const char *end = file.data + file.size;
+  const char *start = begin;
+  while (start < end) {
+    const char *limit = start + std::min(CHUNK_BYTES, (size_t)(end - start));
+    const char *stop = limit == end ? end : next_game(limit, begin, end);
+    chunks.push_back(Chunk{start, stop});
+    start = stop;
+  }
+}
+
+// a move of the game being read, scored once the result is known
+struct GameMove {
+  uint64_t key;
+  uint16_t move;
+  bool white;
+};
+
+struct GameState {
+  Board board;
+  std::vector<GameMove> moves; // this game's book moves so far
+  int ply = 0;
+  bool broken = false; // an unreadable move, nothing after it is recorded
+  int result = -1;     // points for white: 2, 1 or 0, -1 if unknown
+  bool in_game = false;
+  bool in_movetext = false;
+};
+
+static void finish_game(BookBuilder &builder, GameState &game,
+                        std::vector<BookRecord> &records) {
+  if (!game.in_game) {
+    return;
+  }
+  builder.games.fetch_add(1, std::memory_order_relaxed);
+  if (game.broken) {
+    builder.bad_games.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  // unfinished games still count as played, they just earn nothing
+  for (const GameMove &m : game.moves) {
+    uint32_t points = 0;
+    if (game.result >= 0) {
+      points = m.white ? game.result : 2 - game.result;
+    }
+    records.push_back(BookRecord{m.key, m.move, 1, points});
+  }
+  builder.positions.fetch_add(game.moves.size(), std::memory_order_relaxed);
+
+  game.board.set_fen(START_FEN);
+  game.moves.clear();
+  game.ply = 0;
+  game.broken = false;
+  game.result = -1;
+  game.in_game = false;
+  game.in_movetext = false;
+}
+
+// 2, 1 or 0 points for white, -1 for anything else
+static int parse_result(const std::string &text) {
+  if (text == "1-0") {
+    return 2;
+  }
+  if (text == "1/2-1/2") {
+    return 1;
+  }
+  if (text == "0-1") {
+    return 0;
+  }
+  return -1;
+}
+
+static void play_token(BookBuilder &builder, GameState &game,
+                       std::string &token) {
+  // move numbers can be glued to the move, "12.Nf3" or "12...Nf3"
+  size_t start = 0;
+  if (token.compare(0, 3, "0-0") != 0) {
+    while (start < token.size() &&
+           (std::isdigit((unsigned char)token[start]) || token[start] == '.')) {
+      ++start;
+    }
+  }
+  if (start == token.size() || game.broken || game.ply >= builder.max_plies) {
+    return;
+  }
+
+  Move m = parse_san(game.board, token.substr(start));
+  if (m.is_none()) {
+    game.broken = true;
+    return;
+  }
+  game.moves.push_back(GameMove{polyglot_key(game.board), encode_book_move(m),
+                                game.board.side_to_move == WHITE});
+  game.board.make_move(m);
+  ++game.ply;
+}
+
+static void read_chunk(BookBuilder &builder, const Chunk &chunk,
+                       GameState &game, std::vector<BookRecord> &records) {
+  const char *p = chunk.begin;
+  const char *end = chunk.end;
+  int variation_depth = 0;
+  std::string token;
+
+  while (p < end) {
+    char c = *p;
+
+    // a tag pair at the start of a line, the first one after movetext
+    // starts the next game
+    if (c == '[' && (p == chunk.begin || p[-1] == '\n')) {
+      if (game.in_movetext) {
+        finish_game(builder, game, records);
+      }
+      const char *line_end = (const char *)memchr(p, '\n', end - p);
+      if (!line_end) {
+        line_end = end;
+      }
+      std::string tag(p, line_end);
+      if (tag.compare(0, 9, "[Result \"") == 0) {
+        size_t close = tag.find('"', 9);
+        if (close != std::string::npos) {
+          game.result = parse_result(tag.substr(9, close - 9));
+        }
+      } else if (tag.compare(0, 6, "[FEN \"") == 0) {
+        // games from a set up position, an unreadable one is skipped
+        size_t close = tag.find('"', 6);
+        if (close == std::string::npos ||
+            !game.board.set_fen(tag.substr(6, close - 6))) {
+          game.broken = true;
+        }
+      }
+      game.in_game = true;
+      p = line_end;
+      continue;
+    }
+
+    if (c == '{') {
+      const char *close = (const char *)memchr(p, '}', end - p);
+      p = close ? close + 1 : end;
+      continue;
+    }
+    if (c == ';') {
+      const char *line_end = (const char *)memchr(p, '\n', end - p);
+      p = line_end ? line_end : end;
+      continue;
+    }
+    if (c == '(') {
+      ++variation_depth;
+      ++p;
+      continue;
+    }
+    if (c == ')') {
+      variation_depth = std::max(0, variation_depth - 1);
+      ++p;
+      continue;
+    }
+    if (std::isspace((unsigned char)c)) {
+      ++p;
+      continue;
+    }
+
+    const char *token_end = p;
+    while (token_end < end && !std::isspace((unsigned char)*token_end) &&
+           !std::strchr("{}();[", *token_end)) {
+      ++token_end;
+    }
+    if (variation_depth == 0 && c != '$') {
+      token.assign(p, token_end);
+      if (token == "1-0" || token == "0-1" || token == "1/2-1/2" ||
+          token == "*") {
+        if (game.result < 0) {
+          game.result = parse_result(token);
+        }
+        finish_game(builder, game, records);
+      } else {
+        game.in_game = game.in_movetext = true;
+        play_token(builder, game, token);
+      }
+    }
+    p = token_end;
+
+    if (records.size() >= FLUSH_RECORDS) {
+      flush(builder, records);
+    }
+  }
+  finish_game(builder, game, records);
+}
+
+static void book_worker(BookBuilder &builder) {
+  GameState game;
+  std::vector<BookRecord> records;
+  records.reserve(FLUSH_RECORDS + 1024);
+
+  size_t i;
+  while ((i = builder.next_chunk.fetch_add(1)) < builder.chunks.size()) {
+    read_chunk(builder, builder.chunks[i], game, records);
+  }
+  flush(builder, records);
+}
+
+int makebook_command(int argc, char *argv[]) {
+  auto builder = std::make_unique<BookBuilder>();
+  int threads = std::max(1u, std::thread::hardware_concurrency());
+  uint32_t min_games = 1;
+  std::vector<std::string> paths;
+
+  for (int i = 0; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--threads" && i + 1 < argc) {
+      threads = std::max(1, std::atoi(argv[++i]));
+    } else if (arg == "--plies" && i + 1 < argc) {
+      builder->max_plies = std::max(1, std::atoi(argv[++i]));
+    } else if (arg == "--min-games" && i + 1 < argc) {
+      min_games = std::max(1, std::atoi(argv[++i]));
+    } else {
+      paths.push_back(arg);
+    }
+  }
+  if (paths.size() < 2) {
+    cout << "usage: chess_engine makebook [--threads n] [--plies n] "
+            "[--min-games n] <book.bin> <games.pgn>...\n";
+    return 1;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+
+  std::vector<std::unique_ptr<MappedFile>> files;
+  uint64_t bytes = 0;
+  for (size_t i = 1; i < paths.size(); ++i) {
+    files.emplace_back(new MappedFile());
+    if (!files.back()->open(paths[i])) {
+      cout << "Could not open " << paths[i] << '\n';
+      return 1;
+    }
+    bytes += files.back()->size;
+    split_into_chunks(*files.back(), builder->chunks);
+  }
+
+  std::vector<std::thread> workers;
+  for (int i = 0; i < threads; ++i) {
+    workers.emplace_back(book_worker, std::ref(*builder));
+  }
+  for (std::thread &w : workers) {
+    w.join();
+  }
+  double read_seconds = std::chrono::duration<double>(
+                            std::chrono::steady_clock::now() - start)
+                            .count();
+
+  // weights are the points the move scored, moves that never scored are
+  // left out
+  std::vector<BookEntry> entries;
+  for (Shard &shard : builder->shards) {
+    for (const auto &kv : shard.stats) {
+      if (kv.second.games >= min_games && kv.second.points > 0) {
+        entries.push_back(BookEntry{
+            kv.first.key, kv.first.move,
+            (uint16_t)std::min<uint32_t>(kv.second.points, 0xFFFF), 0});
+      }
+    }
+    shard.stats.clear();
+  }
+  if (!write_book(paths[0], entries)) {
+    cout << "Could not write " << paths[0] << '\n';
+    return 1;
+  }
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+
+  cout << "Games: " << builder->games << " (" << builder->bad_games
+       << " with unreadable moves)\n"
+       << "Positions: " << builder->positions << '\n'
+       << "Book entries: " << entries.size() << '\n'
+       << "Input: " << bytes / (1 << 20) << " MB in " << builder->chunks.size()
+       << " chunks on " << threads << " threads\n"
+       << "Reading: " << (int)(read_seconds * 1000) << " ms, "
+       << bytes / 1e9 / std::max(read_seconds, 1e-6) * 60 << " GB/min\n"
+       << "Total: " << (int)(seconds * 1000) << " ms\n";
+  return 0;
+}
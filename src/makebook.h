@@ -0,0 +1,9 @@
+#ifndef MAKEBOOK_H
+#define MAKEBOOK_H
+
+// Entry point for "chess_engine makebook ...": reads PGN files, counts how
+// often and how well each move was played in each position of the opening,
+// and writes the result as a Polyglot book. Returns the process exit code.
+int makebook_command(int argc, char *argv[]);
+
+#endif
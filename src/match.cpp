@@ -0,0 +1,522 @@
+#include "match.h"
+#include "board.h"
+#include "move.h"
+#include "search.h"
+#include "tt.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using std::cout;
+
+constexpr int MATCH_DEFAULT_GAMES = 1000;
+constexpr uint64_t MATCH_DEFAULT_NODES = 20000;
+constexpr size_t MATCH_DEFAULT_HASH_MB = 16; // per engine per game
+
+// a game still going after this many moves each is called a draw
+constexpr int MATCH_DEFAULT_MAX_MOVES = 200;
+
+// openings used without --openings, a few balanced moves into the main lines
+const char *match_openings[] = {
+    "e2e4 e7e5 g1f3 b8c6 f1b5 a7a6",
+    "e2e4 e7e5 g1f3 b8c6 f1c4 f8c5",
+    "e2e4 c7c5 g1f3 d7d6 d2d4 c5d4 f3d4 g8f6 b1c3",
+    "e2e4 e7e6 d2d4 d7d5",
+    "e2e4 c7c6 d2d4 d7d5",
+    "e2e4 d7d5 e4d5 d8d5 b1c3 d5a5",
+    "d2d4 d7d5 c2c4 e7e6 b1c3 g8f6",
+    "d2d4 d7d5 c2c4 c7c6 g1f3 g8f6",
+    "d2d4 g8f6 c2c4 g7g6 b1c3 f8g7 e2e4 d7d6",
+    "d2d4 g8f6 c2c4 e7e6 b1c3 f8b4",
+    "c2c4 e7e5 b1c3 g8f6",
+    "g1f3 d7d5 g2g3 g8f6 f1g2",
+};
+
+// one side of the match: a name and how it searches
+struct MatchEngine {
+  std::string name;
+  SearchLimits limits;
+  size_t hash_mb = MATCH_DEFAULT_HASH_MB;
+};
+
+// a position to start games from and the moves that led to it (none for a
+// position read as FEN), which go into the PGN
+struct Opening {
+  Board board;
+  std::vector<Move> moves;
+};
+
+struct GameRecord {
+  std::string result; // "1-0", "0-1" or "1/2-1/2"
+  std::string reason;
+  std::vector<Move> moves; // from the opening position, its own moves first
+};
+
+// shared by the workers: what to play, and the results so far
+struct Match {
+  MatchEngine engines[2];
+  std::vector<Opening> openings;
+  int games = MATCH_DEFAULT_GAMES;
+  int max_plies = 2 * MATCH_DEFAULT_MAX_MOVES;
+
+  // SPRT hypotheses (Elo of the first engine over the second) and error
+  // rates
+  double elo0 = 0;
+  double elo1 = 5;
+  double alpha = 0.05;
+  double beta = 0.05;
+
+  std::atomic<int> next_game{0};
+  std::atomic<bool> done{false};
+
+  std::mutex mutex; // everything below, and the output
+  int wins = 0;     // for the first engine
+  int draws = 0;
+  int losses = 0;
+  int finished = 0;
+  std::ofstream pgn;
+};
+
+// limits from "nodes", "depth" or "movetime", replacing any other limit
+static bool set_move_limit(SearchLimits &limits, const std::string &kind,
+                           int64_t value) {
+  if (value < 1) {
+    return false;
+  }
+  SearchOptions options = limits.options;
+  if (kind == "nodes") {
+    limits = SearchLimits();
+    limits.nodes = value;
+  } else if (kind == "depth") {
+    limits = SearchLimits();
+    limits.depth = std::min<int64_t>(value, MAX_PLY - 1);
+  } else if (kind == "movetime") {
+    limits = time_limits(value);
+  } else {
+    return false;
+  }
+  limits.options = options;
+  return true;
+}
+
+// spec is a comma separated list of name=<text>, nodes=<n>, depth=<n>,
+// movetime=<ms>, hash=<mb>, no-null-move, no-lmr and no-futility, applied
+// on top of what engine already has. False on anything else.
+static bool parse_engine(const std::string &spec, MatchEngine &engine) {
+  std::istringstream in(spec);
+  std::string item;
+  while (std::getline(in, item, ',')) {
+    size_t eq = item.find('=');
+    std::string key = item.substr(0, eq);
+    std::string value = eq == std::string::npos ? "" : item.substr(eq + 1);
+    if (key == "name" && !value.empty()) {
+      engine.name = value;
+    } else if (key == "nodes" || key == "depth" || key == "movetime") {
+      if (!set_move_limit(engine.limits, key, std::atoll(value.c_str()))) {
+        return false;
+      }
+    } else if (key == "hash") {
+      engine.hash_mb = std::max(1, std::atoi(value.c_str()));
+    } else if (key == "no-null-move") {
+      engine.limits.options.null_move = false;
+    } else if (key == "no-lmr") {
+      engine.limits.options.late_move_reductions = false;
+    } else if (key == "no-futility") {
+      engine.limits.options.futility = false;
+    } else if (!key.empty()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// one opening per line of an EPD or FEN file, false if none could be read
+static bool read_openings(const std::string &path,
+                          std::vector<Opening> &openings) {
+  std::ifstream in(path);
+  std::string line;
+  while (std::getline(in, line)) {
+    if (!line.empty() && line.back() == '\r') {
+      line.pop_back();
+    }
+    Opening opening;
+    if (line.empty() || line[0] == '#' || !opening.board.set_fen(line)) {
+      continue;
+    }
+    openings.push_back(opening);
+  }
+  return !openings.empty();
+}
+
+static bool default_openings(std::vector<Opening> &openings) {
+  for (const char *line : match_openings) {
+    Opening opening;
+    std::istringstream in(line);
+    std::string token;
+    while (in >> token) {
+      Move m = parse_move(opening.board, token);
+      if (m.is_none()) {
+        return false;
+      }
+      opening.board.make_move(m);
+      opening.moves.push_back(m);
+    }
+    openings.push_back(opening);
+  }
+  return true;
+}
+
+// Plays one game from the opening, players[WHITE] against players[BLACK],
+// each searching with its own table. Ends on mate, stalemate, threefold
+// repetition, the fifty move rule, insufficient material or the move limit.
+static GameRecord play_game(const Match &match, const Opening &opening,
+                            const MatchEngine *players[2],
+                            TranspositionTable *tables[2]) {
+  GameRecord game;
+  game.moves = opening.moves;
+
+  // the board keeps the opening's moves, so they count for repetitions
+  Board board = opening.board;
+  int plies = 0;
+
+  while (true) {
+    GameResult state = game_result(board);
+    if (state == GAME_CHECKMATE) {
+      game.result = board.side_to_move == WHITE ? "0-1" : "1-0";
+      game.reason = (board.side_to_move == WHITE ? "Black" : "White") +
+                    std::string(" mates");
+      break;
+    }
+    game.result = "1/2-1/2";
+    if (state == GAME_STALEMATE) {
+      game.reason = "Stalemate";
+      break;
+    }
+    if (state == GAME_REPETITION) {
+      game.reason = "Draw by repetition";
+      break;
+    }
+    if (state == GAME_FIFTY_MOVES) {
+      game.reason = "Draw by fifty move rule";
+      break;
+    }
+    if (state == GAME_INSUFFICIENT_MATERIAL) {
+      game.reason = "Draw by insufficient material";
+      break;
+    }
+    if (plies >= match.max_plies) {
+      game.reason = "Draw by move limit";
+      break;
+    }
+
+    int side = board.side_to_move;
+    SearchResult result =
+        search(board, players[side]->limits, *tables[side]);
+    board.make_move(result.best_move);
+    game.moves.push_back(result.best_move);
+    ++plies;
+  }
+  return game;
+}
+
+static std::string pgn_date() {
+  std::time_t now = std::time(nullptr);
+  char date[16];
+  std::strftime(date, sizeof date, "%Y.%m.%d", std::localtime(&now));
+  return date;
+}
+
+static std::string to_pgn(const Opening &opening, const GameRecord &game,
+                          const std::string &white, const std::string &black,
+                          int round) {
+  std::ostringstream out;
+  out << "[Event \"chess_engine match\"]\n"
+      << "[Site \"?\"]\n"
+      << "[Date \"" << pgn_date() << "\"]\n"
+      << "[Round \"" << round << "\"]\n"
+      << "[White \"" << white << "\"]\n"
+      << "[Black \"" << black << "\"]\n"
+      << "[Result \"" << game.result << "\"]\n";
+
+  // openings given as moves start from the usual position
+  Board board;
+  if (opening.moves.empty()) {
+    board = opening.board;
+    out << "[FEN \"" << board.to_fen() << "\"]\n"
+        << "[SetUp \"1\"]\n";
+  }
+  out << "[PlyCount \"" << game.moves.size() << "\"]\n\n";
+
+  // SAN with move numbers, wrapped before 80 columns
+  std::string text;
+  size_t line_start = 0;
+  int move_number = 1;
+  for (size_t i = 0; i < game.moves.size(); ++i) {
+    std::string token;
+    if (board.side_to_move == WHITE) {
+      token = std::to_string(move_number) + ". ";
+    } else if (i == 0) {
+      token = std::to_string(move_number) + "... ";
+    }
+    token += move_to_san(board, game.moves[i]);
+    if (board.side_to_move == BLACK) {
+      ++move_number;
+    }
+    board.make_move(game.moves[i]);
+
+    if (text.size() - line_start + token.size() + 1 > 79) {
+      text += '\n';
+      line_start = text.size();
+    } else if (!text.empty()) {
+      text += ' ';
+    }
+    text += token;
+  }
+  std::string ending = "{" + game.reason + "} " + game.result;
+  if (text.size() - line_start + ending.size() + 1 > 79) {
+    text += '\n';
+  } else if (!text.empty()) {
+    text += ' ';
+  }
+  out << text << ending << "\n\n";
+  return out.str();
+}
+
+// expected score of a side that is elo stronger, and back
+static double score_from_elo(double elo) {
+  return 1 / (1 + std::pow(10, -elo / 400));
+}
+
+static double elo_from_score(double score) {
+  score = std::max(1e-6, std::min(score, 1 - 1e-6));
+  return -400 * std::log10(1 / score - 1);
+}
+
+// Log likelihood ratio of elo1 over elo0 for the games so far, taking the
+// mean game score as normally distributed with the variance seen in the
+// games (the usual approximation for win/draw/loss results)
+static double sprt_llr(int wins, int draws, int losses, double elo0,
+                       double elo1) {
+  int n = wins + draws + losses;
+  if (n == 0) {
+    return 0;
+  }
+  double score = (wins + 0.5 * draws) / n;
+  double variance = (wins * (1 - score) * (1 - score) +
+                     draws * (0.5 - score) * (0.5 - score) +
+                     losses * score * score) /
+                    n;
+  if (variance <= 0) {
+    return 0;
+  }
+  double s0 = score_from_elo(elo0);
+  double s1 = score_from_elo(elo1);
+  return (s1 - s0) * (2 * score - s0 - s1) * n / (2 * variance);
+}
+
+// "W-D-L, Elo x +- y, LLR z (a, b)" for the first engine, and whether the
+// SPRT has decided (1 for elo1, -1 for elo0, 0 not yet). Called with the
+// match mutex held.
+static std::string match_status(const Match &match, int &verdict) {
+  int n = match.wins + match.draws + match.losses;
+  double score = n > 0 ? (match.wins + 0.5 * match.draws) / n : 0.5;
+  double variance =
+      n > 0 ? (match.wins * (1 - score) * (1 - score) +
+               match.draws * (0.5 - score) * (0.5 - score) +
+               match.losses * score * score) /
+                  n
+            : 0;
+  // 95% confidence interval of the score, as Elo
+  double margin = 1.96 * std::sqrt(variance / std::max(n, 1));
+  double elo = elo_from_score(score);
+  double error = (elo_from_score(score + margin) -
+                  elo_from_score(score - margin)) /
+                 2;
+
+  double llr =
+      sprt_llr(match.wins, match.draws, match.losses, match.elo0, match.elo1);
+  double lower = std::log(match.beta / (1 - match.alpha));
+  double upper = std::log((1 - match.beta) / match.alpha);
+  verdict = llr >= upper ? 1 : llr <= lower ? -1 : 0;
+
+  std::ostringstream out;
+  out << std::fixed << std::setprecision(1) << match.wins << '-'
+      << match.draws << '-' << match.losses << ", Elo " << elo << " +- "
+      << error << std::setprecision(2) << ", LLR " << llr << " (" << lower
+      << ", " << upper << ')';
+  return out.str();
+}
+
+static void match_worker(Match &match) {
+  TranspositionTable tables[2];
+  tables[0].resize(match.engines[0].hash_mb);
+  tables[1].resize(match.engines[1].hash_mb);
+
+  while (!match.done.load()) {
+    int index = match.next_game++;
+    if (index >= match.games) {
+      return;
+    }
+
+    // each opening twice in a row, the first engine white then black
+    const Opening &opening =
+        match.openings[(index / 2) % match.openings.size()];
+    int first = index % 2; // the colour the first engine plays
+    const MatchEngine *players[2] = {&match.engines[first],
+                                     &match.engines[1 - first]};
+    TranspositionTable *player_tables[2] = {&tables[first],
+                                            &tables[1 - first]};
+    tables[0].clear();
+    tables[1].clear();
+
+    GameRecord game = play_game(match, opening, players, player_tables);
+
+    std::lock_guard<std::mutex> lock(match.mutex);
+    if (game.result == "1/2-1/2") {
+      ++match.draws;
+    } else if ((game.result == "1-0") == (first == WHITE)) {
+      ++match.wins;
+    } else {
+      ++match.losses;
+    }
+    ++match.finished;
+    if (match.pgn.is_open()) {
+      match.pgn << to_pgn(opening, game, players[WHITE]->name,
+                          players[BLACK]->name, index + 1);
+    }
+
+    int verdict;
+    cout << "Game " << index + 1 << ": " << players[WHITE]->name << " - "
+         << players[BLACK]->name << ' ' << game.result << " {" << game.reason
+         << "}  " << match_status(match, verdict) << '\n';
+    if (verdict != 0) {
+      match.done = true;
+    }
+  }
+}
+
+// chess_engine match [--games n] [--concurrency n]
+//                    [--nodes n | --depth n | --movetime ms] [--hash mb]
+//                    [--openings file] [--pgn file] [--max-moves n]
+//                    [--elo0 e] [--elo1 e] [--alpha a] [--beta b]
+//                    [--engine1 spec] [--engine2 spec]
+int match_command(int argc, char *argv[]) {
+  auto match = std::make_unique<Match>();
+  int concurrency = std::max(1u, std::thread::hardware_concurrency());
+  SearchLimits limits;
+  limits.nodes = MATCH_DEFAULT_NODES;
+  size_t hash_mb = MATCH_DEFAULT_HASH_MB;
+  std::string specs[2], openings_path, pgn_path;
+  bool ok = true;
+
+  for (int i = 0; i < argc && ok; ++i) {
+    std::string arg = argv[i];
+    if (i + 1 >= argc) {
+      ok = false;
+    } else if (arg == "--games") {
+      match->games = std::max(1, std::atoi(argv[++i]));
+    } else if (arg == "--concurrency") {
+      concurrency = std::max(1, std::atoi(argv[++i]));
+    } else if (arg == "--nodes" || arg == "--depth" || arg == "--movetime") {
+      ok = set_move_limit(limits, arg.substr(2), std::atoll(argv[++i]));
+    } else if (arg == "--hash") {
+      hash_mb = std::max(1, std::atoi(argv[++i]));
+    } else if (arg == "--openings") {
+      openings_path = argv[++i];
+    } else if (arg == "--pgn") {
+      pgn_path = argv[++i];
+    } else if (arg == "--max-moves") {
+      match->max_plies = 2 * std::max(1, std::atoi(argv[++i]));
+    } else if (arg == "--elo0") {
+      match->elo0 = std::atof(argv[++i]);
+    } else if (arg == "--elo1") {
+      match->elo1 = std::atof(argv[++i]);
+    } else if (arg == "--alpha") {
+      match->alpha = std::atof(argv[++i]);
+    } else if (arg == "--beta") {
+      match->beta = std::atof(argv[++i]);
+    } else if (arg == "--engine1") {
+      specs[0] = argv[++i];
+    } else if (arg == "--engine2") {
+      specs[1] = argv[++i];
+    } else {
+      ok = false;
+    }
+  }
+
+  // both engines start from the common settings, then their own spec
+  for (int e = 0; e < 2 && ok; ++e) {
+    MatchEngine &engine = match->engines[e];
+    engine.name = e == 0 ? "engine1" : "engine2";
+    engine.limits = limits;
+    engine.hash_mb = hash_mb;
+    ok = parse_engine(specs[e], engine);
+  }
+  ok = ok && match->elo1 > match->elo0 && match->alpha > 0 &&
+       match->alpha < 1 && match->beta > 0 && match->beta < 1;
+  if (!ok) {
+    cout << "usage: chess_engine match [--games n] [--concurrency n] "
+            "[--nodes n | --depth n | --movetime ms] [--hash mb] "
+            "[--openings file] [--pgn file] [--max-moves n] [--elo0 e] "
+            "[--elo1 e] [--alpha a] [--beta b] [--engine1 spec] "
+            "[--engine2 spec]\n"
+            "spec: comma separated name=<text>, nodes=<n>, depth=<n>, "
+            "movetime=<ms>, hash=<mb>, no-null-move, no-lmr, no-futility\n";
+    return 1;
+  }
+
+  if (openings_path.empty()) {
+    if (!default_openings(match->openings)) {
+      cout << "Invalid built in opening\n";
+      return 1;
+    }
+  } else if (!read_openings(openings_path, match->openings)) {
+    cout << "No positions in " << openings_path << '\n';
+    return 1;
+  }
+  if (!pgn_path.empty()) {
+    match->pgn.open(pgn_path, std::ios::app);
+    if (!match->pgn) {
+      cout << "Could not open " << pgn_path << '\n';
+      return 1;
+    }
+  }
+
+  cout << match->engines[0].name << " vs " << match->engines[1].name << ", "
+       << match->games << " games, " << match->openings.size()
+       << " openings, " << concurrency << " at a time, SPRT elo0 "
+       << match->elo0 << " elo1 " << match->elo1 << '\n';
+
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> workers;
+  for (int i = 0; i < concurrency; ++i) {
+    workers.emplace_back(match_worker, std::ref(*match));
+  }
+  for (std::thread &w : workers) {
+    w.join();
+  }
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+
+  int verdict;
+  std::string status = match_status(*match, verdict);
+  cout << "Finished " << match->finished << " games in " << (int)seconds
+       << " s: " << match->engines[0].name << ' ' << status << '\n'
+       << (verdict > 0   ? "H1 accepted: elo1 is more likely\n"
+           : verdict < 0 ? "H0 accepted: elo0 is more likely\n"
+                         : "SPRT undecided\n");
+  return 0;
+}
@@ -0,0 +1,11 @@
+#ifndef MATCH_H
+#define MATCH_H
+
+// Entry point for "chess_engine match ...": plays two configurations of the
+// engine against each other, one game per thread, each opening once with
+// either colour. Prints the score, the Elo difference and an SPRT verdict as
+// games finish and stops early once the SPRT is decided. Games can be
+// written to a PGN file. Returns the process exit code.
+int match_command(int argc, char *argv[]);
+
+#endif
@@ -1,15 +1,17 @@
 #include "move.h"
+#include <cstdlib>
+#include <cstring>
 
 using std::string;
 
 string move_to_string(const Move &move) {
   string str = "";
 
-  char fromColumn = (move.from % 8) + 'a';
-  char fromRow = (move.from / 8) + '1';
+  char fromColumn = (move.from() % 8) + 'a';
+  char fromRow = (move.from() / 8) + '1';
 
-  char toColumn = (move.to % 8) + 'a';
-  char toRow = (move.to / 8) + '1';
+  char toColumn = (move.to() % 8) + 'a';
+  char toRow = (move.to() / 8) + '1';
 
   str += fromColumn;
   str += fromRow;
@@ -17,31 +19,239 @@ string move_to_string(const Move &move) {
   str += toRow;
 
   // check if promotion
-  if (move.promotion_piece != EMPTY) {
-    switch (move.promotion_piece) {
-    case W_QUEEN:
-    case B_QUEEN:
-      str += 'q';
-      break;
+  switch (move.promotion_piece(WHITE)) {
+  case W_QUEEN:
+    str += 'q';
+    break;
+  case W_ROOK:
+    str += 'r';
+    break;
+  case W_BISHOP:
+    str += 'b';
+    break;
+  case W_KNIGHT:
+    str += 'n';
+    break;
+  default:
+    break;
+  }
 
-    case W_ROOK:
-    case B_ROOK:
-      str += 'r';
-      break;
+  return str;
+}
 
-    case W_BISHOP:
-    case B_BISHOP:
-      str += 'b';
-      break;
+Move parse_move(const Board &board, const string &move_str) {
+  if (move_str.length() < 4) {
+    return Move();
+  }
+
+  MoveList legal_moves;
+  board.generate_legal_moves(legal_moves);
 
-    case W_KNIGHT:
-    case B_KNIGHT:
-      str += 'n';
+  int from_col = move_str[0] - 'a';
+  int from_row = move_str[1] - '1';
+  int to_col = move_str[2] - 'a';
+  int to_row = move_str[3] - '1';
+
+  int from_sq = from_row * 8 + from_col;
+  int to_sq = to_row * 8 + to_col;
+
+  Piece promotion_p = EMPTY;
+  if (move_str.length() == 5) {
+    switch (move_str[4]) {
+    case 'q':
+      promotion_p = (board.side_to_move == WHITE) ? W_QUEEN : B_QUEEN;
+      break;
+    case 'r':
+      promotion_p = (board.side_to_move == WHITE) ? W_ROOK : B_ROOK;
       break;
-    default:
+    case 'b':
+      promotion_p = (board.side_to_move == WHITE) ? W_BISHOP : B_BISHOP;
+      break;
+    case 'n':
+      promotion_p = (board.side_to_move == WHITE) ? W_KNIGHT : B_KNIGHT;
       break;
     }
   }
 
-  return str;
-}
\ No newline at end of file
+  for (const Move &m : legal_moves) {
+    if (m.from() == from_sq && m.to() == to_sq &&
+        (!m.is_promotion() ||
+         m.promotion_piece(board.side_to_move) == promotion_p)) {
+      return m;
+    }
+  }
+
+  return Move();
+}
+
+// SAN letters by piece type, pawns have none in a move but P keeps the
+// indexes lined up
+static const char san_pieces[] = "PNBRQK";
+
+static string square_name(int square) {
+  string name;
+  name += (char)('a' + square % 8);
+  name += (char)('1' + square / 8);
+  return name;
+}
+
+string move_to_san(const Board &board, const Move &move) {
+  Piece p = board.pieces[move.from()];
+  int type = p % 6;
+  string san;
+
+  if (move.is_castling()) {
+    san = move.flags() == MOVE_KING_CASTLE ? "O-O" : "O-O-O";
+  } else {
+    bool capture = move.is_capture();
+    if (type == 0) {
+      if (capture) {
+        san += (char)('a' + move.from() % 8);
+      }
+    } else {
+      san += san_pieces[type];
+
+      // name as much of the from square as it takes to tell this piece
+      // from others of the same kind that could go to the same square
+      MoveList legal_moves;
+      board.generate_legal_moves(legal_moves);
+      bool ambiguous = false, same_file = false, same_row = false;
+      for (const Move &other : legal_moves) {
+        if (other.to() == move.to() && other.from() != move.from() &&
+            board.pieces[other.from()] == p) {
+          ambiguous = true;
+          same_file |= other.from() % 8 == move.from() % 8;
+          same_row |= other.from() / 8 == move.from() / 8;
+        }
+      }
+      if (ambiguous) {
+        if (!same_file) {
+          san += (char)('a' + move.from() % 8);
+        } else if (!same_row) {
+          san += (char)('1' + move.from() / 8);
+        } else {
+          san += square_name(move.from());
+        }
+      }
+    }
+    if (capture) {
+      san += 'x';
+    }
+    san += square_name(move.to());
+    if (move.is_promotion()) {
+      san += '=';
+      san += san_pieces[move.promotion_piece(WHITE)];
+    }
+  }
+
+  Board after = board;
+  after.make_move(move);
+  if (after.is_in_check()) {
+    MoveList replies;
+    after.generate_legal_moves(replies);
+    san += replies.empty() ? '#' : '+';
+  }
+  return san;
+}
+
+Move parse_san(const Board &board, const string &san) {
+  string s = san;
+  while (!s.empty() && std::strchr("+#!?", s.back())) {
+    s.pop_back();
+  }
+
+  MoveList legal_moves;
+  board.generate_legal_moves(legal_moves);
+
+  if (s == "O-O" || s == "0-0" || s == "O-O-O" || s == "0-0-0") {
+    int king = board.king_square[board.side_to_move];
+    int to = s.size() == 3 ? king + 2 : king - 2;
+    for (const Move &m : legal_moves) {
+      if (m.from() == king && m.to() == to) {
+        return m;
+      }
+    }
+    return Move();
+  }
+
+  int type = 0;
+  size_t start = 0;
+  if (!s.empty() && std::strchr("NBRQK", s[0])) {
+    type = std::strchr(san_pieces, s[0]) - san_pieces;
+    start = 1;
+  }
+
+  // promotion, e8=Q or e8Q
+  int promotion = -1;
+  if (type == 0 && !s.empty() && std::strchr("NBRQ", s.back())) {
+    promotion = std::strchr(san_pieces, s.back()) - san_pieces;
+    s.pop_back();
+    if (!s.empty() && s.back() == '=') {
+      s.pop_back();
+    }
+  }
+
+  if (s.size() < start + 2) {
+    return Move();
+  }
+  char to_file = s[s.size() - 2];
+  char to_rank = s[s.size() - 1];
+  if (to_file < 'a' || to_file > 'h' || to_rank < '1' || to_rank > '8') {
+    return Move();
+  }
+  int to = (to_rank - '1') * 8 + (to_file - 'a');
+
+  // whatever is left between the piece and the destination is
+  // disambiguation and the capture mark
+  int from_file = -1, from_row = -1;
+  for (size_t i = start; i < s.size() - 2; ++i) {
+    char c = s[i];
+    if (c >= 'a' && c <= 'h') {
+      from_file = c - 'a';
+    } else if (c >= '1' && c <= '8') {
+      from_row = c - '1';
+    } else if (c != 'x') {
+      return Move();
+    }
+  }
+
+  Move found;
+  int matches = 0;
+  for (const Move &m : legal_moves) {
+    int m_promotion = m.is_promotion() ? m.promotion_piece(WHITE) : -1;
+    if (m.to() == to && board.pieces[m.from()] % 6 == type &&
+        m_promotion == promotion &&
+        (from_file == -1 || m.from() % 8 == from_file) &&
+        (from_row == -1 || m.from() / 8 == from_row)) {
+      found = m;
+      ++matches;
+    }
+  }
+  return matches == 1 ? found : Move();
+}
+
+// neither side can ever mate: bare kings, or a single knight or bishop
+static bool insufficient_material(const Board &board) {
+  Bitboard kings = board.piece_bb[W_KING] | board.piece_bb[B_KING];
+  Bitboard minors = board.piece_bb[W_KNIGHT] | board.piece_bb[B_KNIGHT] |
+                    board.piece_bb[W_BISHOP] | board.piece_bb[B_BISHOP];
+  return (board.occupied & ~kings) == minors && popcount(minors) <= 1;
+}
+
+GameResult game_result(const Board &board) {
+  MoveList moves;
+  board.generate_legal_moves(moves);
+  if (moves.empty()) {
+    return board.is_in_check() ? GAME_CHECKMATE : GAME_STALEMATE;
+  }
+  if (board.is_repetition(2)) {
+    return GAME_REPETITION;
+  }
+  if (board.halfmove_clock >= FIFTY_MOVE_PLIES) {
+    return GAME_FIFTY_MOVES;
+  }
+  if (insufficient_material(board)) {
+    return GAME_INSUFFICIENT_MATERIAL;
+  }
+  return GAME_ONGOING;
+}
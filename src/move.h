@@ -2,25 +2,120 @@
 #define MOVE_H
 
 #include "board.h"
+#include <cstdint>
 #include <string>
 
 using std::string;
 
+// What kind of move it is, stored in the top four bits of Move. Bit 2 marks
+// captures and bit 3 promotions, whose low two bits give the piece.
+enum MoveFlag {
+  MOVE_QUIET = 0,
+  MOVE_DOUBLE_PUSH = 1,
+  MOVE_KING_CASTLE = 2,
+  MOVE_QUEEN_CASTLE = 3,
+  MOVE_CAPTURE = 4,
+  MOVE_EN_PASSANT = 5,
+  MOVE_PROMOTION = 8, // + 0 knight, 1 bishop, 2 rook, 3 queen
+  MOVE_PROMOTION_CAPTURE = 12
+};
+
+// A move in 16 bits: from square in bits 0-5, to square in 6-11 and the
+// MoveFlag in 12-15. The move generators fill in the flag, so nothing
+// afterwards has to look at the board to tell what the move does.
 struct Move {
-  int from = 0; // index 0-63
-  int to = 0;   // index 0-63
-  Piece promotion_piece = EMPTY;
+  uint16_t data = 0;
+
+  // the null move (a1a1, never legal) stands for "no move"
+  Move() = default;
+
+  Move(int from, int to, int flags = MOVE_QUIET)
+      : data((uint16_t)(from | to << 6 | flags << 12)) {}
+
+  int from() const { return data & 0x3F; }
+  int to() const { return (data >> 6) & 0x3F; }
+  int flags() const { return data >> 12; }
+
+  bool is_none() const { return data == 0; }
+  bool is_capture() const { return flags() & MOVE_CAPTURE; }
+  bool is_promotion() const { return flags() & MOVE_PROMOTION; }
+  bool is_en_passant() const { return flags() == MOVE_EN_PASSANT; }
+  bool is_castling() const {
+    return flags() == MOVE_KING_CASTLE || flags() == MOVE_QUEEN_CASTLE;
+  }
+
+  // the piece side's pawn turns into, EMPTY if this isn't a promotion
+  Piece promotion_piece(Side side) const {
+    if (!is_promotion()) {
+      return EMPTY;
+    }
+    return (Piece)(W_KNIGHT + (flags() & 3) + (side == WHITE ? 0 : B_PAWN));
+  }
+
+  bool operator==(const Move &other) const { return data == other.data; }
+  bool operator!=(const Move &other) const { return data != other.data; }
+};
 
-  // Default Constructor
-  Move() : from(0), to(0), promotion_piece(EMPTY) {}
+// the flag of a promotion to piece (of either colour)
+inline int promotion_flag(Piece piece, bool capture) {
+  return MOVE_PROMOTION | (piece % 6 - W_KNIGHT) |
+         (capture ? MOVE_CAPTURE : 0);
+}
 
-  // Normal Move Constructor
-  Move(int from, int to) : from(from), to(to), promotion_piece(EMPTY) {}
+// no legal position has more than 218 moves
+constexpr int MAX_MOVES = 256;
 
-  // Promotion Move Constructor
-  Move(int from, int to, Piece promo)
-      : from(from), to(to), promotion_piece(promo) {}
+// Fixed capacity move list that lives on the stack, so generating moves
+// never touches the heap
+struct MoveList {
+  // in an anonymous union the array is left unconstructed, there is no point
+  // default constructing 256 moves that are about to be overwritten
+  union {
+    Move moves[MAX_MOVES];
+  };
+  int count = 0;
+
+  MoveList() {}
+
+  void push_back(Move m) { moves[count++] = m; }
+  void clear() { count = 0; }
+  int size() const { return count; }
+  bool empty() const { return count == 0; }
+
+  Move &operator[](int i) { return moves[i]; }
+  const Move &operator[](int i) const { return moves[i]; }
+
+  Move *begin() { return moves; }
+  Move *end() { return moves + count; }
+  const Move *begin() const { return moves; }
+  const Move *end() const { return moves + count; }
 };
 
 string move_to_string(const Move &move);
+
+// Finds the legal move written in coordinate notation (e2e4, e7e8q), returns
+// the null move if there is no such move
+Move parse_move(const Board &board, const string &move_str);
+
+// Standard algebraic notation (Nf3, exd5, O-O, e8=Q+) of a legal move in
+// board's position
+string move_to_san(const Board &board, const Move &move);
+
+// Finds the legal move written in SAN, returns the null move if there is no
+// such move or the text could mean more than one. Check, mate and
+// annotation marks are ignored, and the "=" before a promotion is optional.
+Move parse_san(const Board &board, const string &san);
+
+// how the game stands for the side to move: mated, or drawn by stalemate,
+// threefold repetition, the fifty move rule or with too little material left
+// for either side to mate
+enum GameResult {
+  GAME_ONGOING,
+  GAME_CHECKMATE,
+  GAME_STALEMATE,
+  GAME_REPETITION,
+  GAME_FIFTY_MOVES,
+  GAME_INSUFFICIENT_MATERIAL
+};
+GameResult game_result(const Board &board);
 #endif
\ No newline at end of file
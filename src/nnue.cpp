@@ -0,0 +1,210 @@
+#include "nnue.h"
+#include <fstream>
+#include <vector>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+bool nnue_enabled = false;
+
+struct Network {
+  alignas(32) int16_t feature_weights[NNUE_INPUTS][NNUE_HIDDEN];
+  alignas(32) int16_t feature_bias[NNUE_HIDDEN];
+  alignas(32) int16_t output_weights[2][NNUE_HIDDEN];
+  int16_t output_bias;
+};
+
+static Network network;
+
+// input index of a piece on a square as seen by perspective: the board is
+// flipped for black so both sides see their own pieces first and moving up
+static int feature_index(int perspective, int piece, int square) {
+  int colour = piece / 6;
+  int type = piece % 6;
+  if (perspective == 1) {
+    colour ^= 1;
+    square ^= 56;
+  }
+  return colour * 384 + type * 64 + square;
+}
+
+// Vector kernels. Every loop below walks NNUE_HIDDEN int16 values, which is a
+// whole number of registers at either width. Without SSE2 or AVX2 they fall
+// back to plain loops.
+#if defined(__AVX2__)
+#define USE_SIMD
+typedef __m256i vec_t;
+constexpr int VEC_WIDTH = 16;
+static inline vec_t vec_load(const int16_t *p) {
+  return _mm256_load_si256((const __m256i *)p);
+}
+static inline void vec_store(int16_t *p, vec_t v) {
+  _mm256_store_si256((__m256i *)p, v);
+}
+static inline vec_t vec_add_16(vec_t a, vec_t b) {
+  return _mm256_add_epi16(a, b);
+}
+static inline vec_t vec_sub_16(vec_t a, vec_t b) {
+  return _mm256_sub_epi16(a, b);
+}
+static inline vec_t vec_clamp(vec_t v) {
+  return _mm256_min_epi16(_mm256_max_epi16(v, _mm256_setzero_si256()),
+                          _mm256_set1_epi16(NNUE_QA));
+}
+static inline vec_t vec_zero() { return _mm256_setzero_si256(); }
+// multiplies int16 lanes and adds neighbouring pairs into int32 lanes
+static inline vec_t vec_madd(vec_t a, vec_t b) {
+  return _mm256_madd_epi16(a, b);
+}
+static inline vec_t vec_add_32(vec_t a, vec_t b) {
+  return _mm256_add_epi32(a, b);
+}
+static inline int vec_sum_32(vec_t v) {
+  __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(v),
+                              _mm256_extracti128_si256(v, 1));
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E));
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xB1));
+  return _mm_cvtsi128_si32(sum);
+}
+#elif defined(__SSE2__)
+#define USE_SIMD
+typedef __m128i vec_t;
+constexpr int VEC_WIDTH = 8;
+static inline vec_t vec_load(const int16_t *p) {
+  return _mm_load_si128((const __m128i *)p);
+}
+static inline void vec_store(int16_t *p, vec_t v) {
+  _mm_store_si128((__m128i *)p, v);
+}
+static inline vec_t vec_add_16(vec_t a, vec_t b) { return _mm_add_epi16(a, b); }
+static inline vec_t vec_sub_16(vec_t a, vec_t b) { return _mm_sub_epi16(a, b); }
+static inline vec_t vec_clamp(vec_t v) {
+  return _mm_min_epi16(_mm_max_epi16(v, _mm_setzero_si128()),
+                       _mm_set1_epi16(NNUE_QA));
+}
+static inline vec_t vec_zero() { return _mm_setzero_si128(); }
+static inline vec_t vec_madd(vec_t a, vec_t b) { return _mm_madd_epi16(a, b); }
+static inline vec_t vec_add_32(vec_t a, vec_t b) { return _mm_add_epi32(a, b); }
+static inline int vec_sum_32(vec_t v) {
+  v = _mm_add_epi32(v, _mm_shuffle_epi32(v, 0x4E));
+  v = _mm_add_epi32(v, _mm_shuffle_epi32(v, 0xB1));
+  return _mm_cvtsi128_si32(v);
+}
+#endif
+
+// stands in for the missing column when a piece is only added or removed,
+// so update() has no branches in its loop
+alignas(32) static const int16_t zero_column[NNUE_HIDDEN] = {};
+
+// acc += add - sub
+static void update(int16_t *acc, const int16_t *add, const int16_t *sub) {
+#ifdef USE_SIMD
+  for (int i = 0; i < NNUE_HIDDEN; i += VEC_WIDTH) {
+    vec_store(acc + i, vec_sub_16(vec_add_16(vec_load(acc + i),
+                                             vec_load(add + i)),
+                                  vec_load(sub + i)));
+  }
+#else
+  for (int i = 0; i < NNUE_HIDDEN; ++i) {
+    acc[i] += add[i] - sub[i];
+  }
+#endif
+}
+
+// sum of clamp(acc) * weights over one half of the hidden layer
+static int dot_clamped(const int16_t *acc, const int16_t *weights) {
+#ifdef USE_SIMD
+  vec_t sum = vec_zero();
+  for (int i = 0; i < NNUE_HIDDEN; i += VEC_WIDTH) {
+    sum = vec_add_32(
+        sum, vec_madd(vec_clamp(vec_load(acc + i)), vec_load(weights + i)));
+  }
+  return vec_sum_32(sum);
+#else
+  int sum = 0;
+  for (int i = 0; i < NNUE_HIDDEN; ++i) {
+    int v = acc[i] < 0 ? 0 : (acc[i] > NNUE_QA ? NNUE_QA : acc[i]);
+    sum += v * weights[i];
+  }
+  return sum;
+#endif
+}
+
+bool nnue_load(const std::string &path) {
+  std::ifstream file(path, std::ios::binary | std::ios::ate);
+  if (!file) {
+    return false;
+  }
+
+  constexpr size_t count = NNUE_INPUTS * NNUE_HIDDEN + NNUE_HIDDEN +
+                           2 * NNUE_HIDDEN + 1;
+  if ((size_t)file.tellg() != count * sizeof(int16_t)) {
+    return false;
+  }
+  file.seekg(0);
+
+  std::vector<int16_t> values(count);
+  if (!file.read((char *)values.data(), count * sizeof(int16_t))) {
+    return false;
+  }
+
+  const int16_t *p = values.data();
+  for (int i = 0; i < NNUE_INPUTS; ++i) {
+    for (int j = 0; j < NNUE_HIDDEN; ++j) {
+      network.feature_weights[i][j] = *p++;
+    }
+  }
+  for (int j = 0; j < NNUE_HIDDEN; ++j) {
+    network.feature_bias[j] = *p++;
+  }
+  for (int side = 0; side < 2; ++side) {
+    for (int j = 0; j < NNUE_HIDDEN; ++j) {
+      network.output_weights[side][j] = *p++;
+    }
+  }
+  network.output_bias = *p;
+
+  nnue_enabled = true;
+  return true;
+}
+
+void nnue_reset(Accumulator &acc) {
+  for (int perspective = 0; perspective < 2; ++perspective) {
+    for (int j = 0; j < NNUE_HIDDEN; ++j) {
+      acc.values[perspective][j] = network.feature_bias[j];
+    }
+  }
+}
+
+void nnue_add_piece(Accumulator &acc, int piece, int square) {
+  for (int perspective = 0; perspective < 2; ++perspective) {
+    update(acc.values[perspective],
+           network.feature_weights[feature_index(perspective, piece, square)],
+           zero_column);
+  }
+}
+
+void nnue_remove_piece(Accumulator &acc, int piece, int square) {
+  for (int perspective = 0; perspective < 2; ++perspective) {
+    update(acc.values[perspective], zero_column,
+           network.feature_weights[feature_index(perspective, piece, square)]);
+  }
+}
+
+void nnue_move_piece(Accumulator &acc, int piece, int from, int to) {
+  // one pass over the accumulator instead of a remove and an add
+  for (int perspective = 0; perspective < 2; ++perspective) {
+    update(acc.values[perspective],
+           network.feature_weights[feature_index(perspective, piece, to)],
+           network.feature_weights[feature_index(perspective, piece, from)]);
+  }
+}
+
+int nnue_evaluate(const Accumulator &acc, int side) {
+  int sum = dot_clamped(acc.values[side], network.output_weights[0]) +
+            dot_clamped(acc.values[side ^ 1], network.output_weights[1]);
+  // the output bias is stored at the same QA * QB scale as the sum
+  return (int)((int64_t)(sum + network.output_bias) * NNUE_SCALE /
+               (NNUE_QA * NNUE_QB));
+}
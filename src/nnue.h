@@ -0,0 +1,45 @@
+#ifndef NNUE_H
+#define NNUE_H
+
+#include <cstdint>
+#include <string>
+
+// A small efficiently updatable network: 768 inputs (colour x piece type x
+// square, seen from each side) feed NNUE_HIDDEN neurons per side, and the two
+// halves, side to move first, feed a single output.
+constexpr int NNUE_INPUTS = 768;
+constexpr int NNUE_HIDDEN = 256;
+
+// quantisation: the accumulator is clipped to [0, NNUE_QA], output weights
+// are scaled by NNUE_QB, and NNUE_SCALE turns the result into centipawns
+constexpr int NNUE_QA = 255;
+constexpr int NNUE_QB = 64;
+constexpr int NNUE_SCALE = 400;
+
+// first layer outputs for both perspectives, indexed by Side
+struct Accumulator {
+  alignas(32) int16_t values[2][NNUE_HIDDEN];
+};
+
+// true once a network has been loaded. Board only keeps its accumulator up
+// to date while this is set, so load before setting up any positions.
+extern bool nnue_enabled;
+
+// Reads the network from a file of little endian int16 values: feature
+// weights [768][NNUE_HIDDEN], feature biases [NNUE_HIDDEN], output weights
+// [2][NNUE_HIDDEN] then the output bias. Returns false (and leaves the
+// classical evaluation in charge) if the file is missing or the wrong size.
+bool nnue_load(const std::string &path);
+
+// Sets the accumulator to the biases, pieces are then added one at a time
+void nnue_reset(Accumulator &acc);
+
+// piece is a Piece value (W_PAWN..B_KING), square is 0-63
+void nnue_add_piece(Accumulator &acc, int piece, int square);
+void nnue_remove_piece(Accumulator &acc, int piece, int square);
+void nnue_move_piece(Accumulator &acc, int piece, int from, int to);
+
+// Score in centipawns from the point of view of side (a Side value)
+int nnue_evaluate(const Accumulator &acc, int side);
+
+#endif
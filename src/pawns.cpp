@@ -0,0 +1,132 @@
+#include "pawns.h"
+
+constexpr int DOUBLED_MG = -10;
+constexpr int DOUBLED_EG = -25;
+constexpr int ISOLATED_MG = -8;
+constexpr int ISOLATED_EG = -12;
+constexpr int BACKWARD_MG = -8;
+constexpr int BACKWARD_EG = -8;
+constexpr int SHIELD_MG = 12;
+
+// by rank counted from the pawn's own side, on top of the piece-square
+// tables which already pay for advancing
+constexpr int passed_mg[8] = {0, 0, 5, 10, 20, 35, 55, 0};
+constexpr int passed_eg[8] = {0, 5, 10, 25, 45, 75, 110, 0};
+
+// [side][square] of a pawn: the squares ahead of it on its file, the same on
+// the neighbouring files too (no enemy pawn there means it is passed), and
+// the neighbouring files level with it or behind (where a pawn that could
+// defend it has to be)
+static Bitboard forward_file[2][64];
+static Bitboard passed_span[2][64];
+static Bitboard support_span[2][64];
+// [side][king square] the three files around the king, two ranks ahead
+static Bitboard shield_span[2][64];
+static Bitboard adjacent_files[8];
+
+static bool build_masks() {
+  for (int file = 0; file < 8; ++file) {
+    adjacent_files[file] = (file > 0 ? FILE_A_BB << (file - 1) : 0) |
+                           (file < 7 ? FILE_A_BB << (file + 1) : 0);
+  }
+  for (int sq = 0; sq < 64; ++sq) {
+    int file = sq % 8;
+    int rank = sq / 8;
+    Bitboard around = adjacent_files[file] | (FILE_A_BB << file);
+    Bitboard above = 0, below = 0;
+    for (int r = rank + 1; r < 8; ++r) {
+      above |= RANK_1_BB << (8 * r);
+    }
+    for (int r = rank - 1; r >= 0; --r) {
+      below |= RANK_1_BB << (8 * r);
+    }
+    Bitboard level = RANK_1_BB << (8 * rank);
+
+    forward_file[WHITE][sq] = (FILE_A_BB << file) & above;
+    forward_file[BLACK][sq] = (FILE_A_BB << file) & below;
+    passed_span[WHITE][sq] = around & above;
+    passed_span[BLACK][sq] = around & below;
+    support_span[WHITE][sq] = adjacent_files[file] & (below | level);
+    support_span[BLACK][sq] = adjacent_files[file] & (above | level);
+
+    Bitboard two_up = rank < 7 ? RANK_1_BB << (8 * (rank + 1)) : 0;
+    two_up |= rank < 6 ? RANK_1_BB << (8 * (rank + 2)) : 0;
+    Bitboard two_down = rank > 0 ? RANK_1_BB << (8 * (rank - 1)) : 0;
+    two_down |= rank > 1 ? RANK_1_BB << (8 * (rank - 2)) : 0;
+    shield_span[WHITE][sq] = rank <= 1 ? around & two_up : 0;
+    shield_span[BLACK][sq] = rank >= 6 ? around & two_down : 0;
+  }
+  return true;
+}
+
+void init_pawns() {
+  // function-local static, so concurrent first calls still build once
+  static const bool initialized = build_masks();
+  (void)initialized;
+}
+
+PawnEntry evaluate_pawns(const Board &board) {
+  PawnEntry entry;
+  entry.key = board.pawn_key;
+
+  for (Side side : {WHITE, BLACK}) {
+    int sign = side == WHITE ? 1 : -1;
+    Bitboard own = board.piece_bb[side == WHITE ? W_PAWN : B_PAWN];
+    Bitboard enemy = board.piece_bb[side == WHITE ? B_PAWN : W_PAWN];
+
+    int mg = 0, eg = 0;
+    Bitboard b = own;
+    while (b) {
+      int sq = pop_lsb(b);
+      int stop = side == WHITE ? sq + 8 : sq - 8;
+      int rank = side == WHITE ? sq / 8 : 7 - sq / 8;
+      bool blocked_by_own = own & forward_file[side][sq];
+
+      // only the rear pawn of a doubled pair pays
+      if (blocked_by_own) {
+        mg += DOUBLED_MG;
+        eg += DOUBLED_EG;
+      }
+      if (!(own & adjacent_files[sq % 8])) {
+        mg += ISOLATED_MG;
+        eg += ISOLATED_EG;
+      } else if (!(own & support_span[side][sq]) &&
+                 (pawn_attacks[side][stop] & enemy)) {
+        // no pawn can come up to defend it and it can't advance safely
+        mg += BACKWARD_MG;
+        eg += BACKWARD_EG;
+      }
+      if (!blocked_by_own && !(enemy & passed_span[side][sq])) {
+        mg += passed_mg[rank];
+        eg += passed_eg[rank];
+      }
+    }
+    entry.mg += sign * mg;
+    entry.eg += sign * eg;
+  }
+  return entry;
+}
+
+const PawnEntry &PawnTable::probe(const Board &board) {
+  PawnEntry &entry = entries[board.pawn_key & (entries.size() - 1)];
+  ++probes;
+  // an unused slot has key 0, which is also the key (and the score) of no
+  // pawns at all
+  if (entry.key == board.pawn_key) {
+    ++hits;
+  } else {
+    entry = evaluate_pawns(board);
+  }
+  return entry;
+}
+
+int king_shield(const Board &board) {
+  int score = 0;
+  for (Side side : {WHITE, BLACK}) {
+    int king = board.king_square[side];
+    Bitboard own = board.piece_bb[side == WHITE ? W_PAWN : B_PAWN];
+    int shield = popcount(own & shield_span[side][king]) * SHIELD_MG;
+    score += side == WHITE ? shield : -shield;
+  }
+  return score;
+}
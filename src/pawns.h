@@ -0,0 +1,44 @@
+#ifndef PAWNS_H
+#define PAWNS_H
+
+#include "board.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Passed, doubled, isolated and backward pawn terms, white minus black.
+// They only depend on where the pawns are, so they are cached by
+// Board::pawn_key.
+struct PawnEntry {
+  uint64_t key = 0;
+  int mg = 0;
+  int eg = 0;
+};
+
+// pawn structures remembered per search thread, 16 bytes each
+constexpr size_t PAWN_TABLE_ENTRIES = 1 << 14;
+
+// A small always-replace cache owned by one thread, so it needs no locking.
+// probes and hits say how well it is sized for the searches it sees.
+struct PawnTable {
+  std::vector<PawnEntry> entries;
+  uint64_t probes = 0;
+  uint64_t hits = 0;
+
+  explicit PawnTable(size_t count = PAWN_TABLE_ENTRIES) : entries(count) {}
+
+  // the entry for the board's pawns, computed and stored on a miss
+  const PawnEntry &probe(const Board &board);
+};
+
+// Fills the pawn masks, only does the work the first time it is called
+void init_pawns();
+
+// the pawn structure terms from scratch, what the table stores
+PawnEntry evaluate_pawns(const Board &board);
+
+// Middlegame bonus for pawns in front of a king on its first two ranks,
+// white minus black. It moves with the king so it isn't cached.
+int king_shield(const Board &board);
+
+#endif
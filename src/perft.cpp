@@ -0,0 +1,169 @@
+#include "perft.h"
+#include "move.h"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+using std::cout;
+
+struct PerftPosition {
+  const char *name;
+  const char *fen;
+  int depth;
+  uint64_t nodes;
+};
+
+// known counts from the chess programming wiki and the usual edge case suite
+const PerftPosition reference_positions[] = {
+    {"start position", "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+     5, 4865609},
+    {"kiwipete",
+     "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", 4,
+     4085603},
+    {"position 3", "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", 5, 674624},
+    {"position 4",
+     "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", 4,
+     422333},
+    {"position 5", "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+     4, 2103487},
+    {"illegal ep move 1", "3k4/3p4/8/K1P4r/8/8/8/8 b - - 0 1", 6, 1134888},
+    {"illegal ep move 2", "8/8/4k3/8/2p5/8/B2P2K1/8 w - - 0 1", 6, 1015133},
+    {"ep capture checks opponent", "8/8/1k6/2b5/2pP4/8/5K2/8 b - d3 0 1", 6,
+     1440467},
+    {"short castling gives check", "5k2/8/8/8/8/8/8/4K2R w K - 0 1", 6, 661072},
+    {"long castling gives check", "3k4/8/8/8/8/8/8/R3K3 w Q - 0 1", 6, 803711},
+    {"castling prevented", "r3k2r/8/3Q4/8/8/5q2/8/R3K2R b KQkq - 0 1", 4,
+     1720476},
+    {"promote out of check", "2K2r2/4P3/8/8/8/8/8/3k4 w - - 0 1", 6, 3821001},
+    {"discovered check", "8/8/1P2K3/8/2n5/1q6/8/5k2 b - - 0 1", 5, 1004658},
+    {"promote to give check", "4k3/1P6/8/8/8/8/K7/8 w - - 0 1", 6, 217342},
+    {"under promote to give check", "8/P1k5/K7/8/8/8/8/8 w - - 0 1", 6, 92683},
+    {"self stalemate", "K1k5/8/P7/8/8/8/8/8 w - - 0 1", 6, 2217},
+    {"stalemate and checkmate 1", "8/k1P5/8/1K6/8/8/8/8 w - - 0 1", 7, 567584},
+    {"stalemate and checkmate 2", "8/8/2k5/5q2/5n2/8/5K2/8 b - - 0 1", 4,
+     23527},
+};
+
+static double seconds_since(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+static uint64_t nodes_per_second(uint64_t nodes, double seconds) {
+  return seconds > 0 ? (uint64_t)(nodes / seconds) : 0;
+}
+
+uint64_t perft(Board &board, int depth) {
+  if (depth == 0) {
+    return 1;
+  }
+
+  MoveList moves;
+  board.generate_legal_moves(moves);
+
+  // bulk count, no need to make the last ply of moves
+  if (depth == 1) {
+    return moves.size();
+  }
+
+  uint64_t nodes = 0;
+  for (Move m : moves) {
+    board.make_move(m);
+    nodes += perft(board, depth - 1);
+    board.unmake_move(m);
+  }
+  return nodes;
+}
+
+uint64_t perft_divide(Board &board, int depth) {
+  auto start = std::chrono::steady_clock::now();
+
+  MoveList moves;
+  board.generate_legal_moves(moves);
+
+  uint64_t total = 0;
+  for (Move m : moves) {
+    board.make_move(m);
+    uint64_t nodes = perft(board, depth - 1);
+    board.unmake_move(m);
+
+    cout << move_to_string(m) << ": " << nodes << '\n';
+    total += nodes;
+  }
+
+  double seconds = seconds_since(start);
+  cout << "\nMoves: " << moves.size() << '\n';
+  cout << "Nodes: " << total << '\n';
+  cout << "Time: " << (int)(seconds * 1000) << " ms\n";
+  cout << "NPS: " << nodes_per_second(total, seconds) << '\n';
+  return total;
+}
+
+bool run_perft_suite() {
+  bool all_passed = true;
+  uint64_t total_nodes = 0;
+  auto start = std::chrono::steady_clock::now();
+
+  for (const PerftPosition &pos : reference_positions) {
+    Board board;
+    if (!board.set_fen(pos.fen)) {
+      cout << "FAIL " << pos.name << ": bad fen\n";
+      all_passed = false;
+      continue;
+    }
+
+    auto position_start = std::chrono::steady_clock::now();
+    uint64_t nodes = perft(board, pos.depth);
+    double seconds = seconds_since(position_start);
+    total_nodes += nodes;
+
+    bool passed = nodes == pos.nodes;
+    all_passed = all_passed && passed;
+
+    cout << (passed ? "ok   " : "FAIL ") << pos.name << " depth " << pos.depth
+         << ": " << nodes;
+    if (!passed) {
+      cout << " (expected " << pos.nodes << ")";
+    }
+    cout << ", " << nodes_per_second(nodes, seconds) << " nps\n";
+  }
+
+  double seconds = seconds_since(start);
+  cout << "\nTotal nodes: " << total_nodes << '\n';
+  cout << "Time: " << (int)(seconds * 1000) << " ms\n";
+  cout << "NPS: " << nodes_per_second(total_nodes, seconds) << '\n';
+  cout << (all_passed ? "All positions passed\n" : "Some positions FAILED\n");
+  return all_passed;
+}
+
+int perft_command(int argc, char *argv[]) {
+  if (argc >= 1 && std::string(argv[0]) == "suite") {
+    return run_perft_suite() ? 0 : 1;
+  }
+
+  int depth = argc >= 1 ? std::atoi(argv[0]) : 0;
+  if (depth < 1) {
+    cout << "usage: chess_engine perft <depth> [fen]\n"
+         << "       chess_engine perft suite\n";
+    return 1;
+  }
+
+  // the fen comes in as separate arguments unless it was quoted
+  std::string fen;
+  for (int i = 1; i < argc; ++i) {
+    if (i > 1) {
+      fen += ' ';
+    }
+    fen += argv[i];
+  }
+
+  Board board;
+  if (!fen.empty() && !board.set_fen(fen)) {
+    cout << "Invalid FEN: " << fen << '\n';
+    return 1;
+  }
+
+  perft_divide(board, depth);
+  return 0;
+}
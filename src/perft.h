@@ -0,0 +1,22 @@
+#ifndef PERFT_H
+#define PERFT_H
+
+#include "board.h"
+#include <cstdint>
+
+// Count the leaf nodes of the legal move tree to the given depth
+uint64_t perft(Board &board, int depth);
+
+// Same as perft but prints the count under each root move, plus the total,
+// the time taken and nodes per second
+uint64_t perft_divide(Board &board, int depth);
+
+// Runs every reference position against its known node count, returns true
+// if they all match
+bool run_perft_suite();
+
+// Entry point for "chess_engine perft ...", args are everything after
+// "perft". Returns the process exit code.
+int perft_command(int argc, char *argv[]);
+
+#endif
@@ -0,0 +1,833 @@
+#include "search.h"
+#include "tablebase.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iterator>
+#include <memory>
+#include <sstream>
+#include <thread>
+#include <utility>
+#include <vector>
+
+SearchLimits time_limits(int64_t move_time_ms) {
+  SearchLimits limits;
+  limits.soft_time_ms = std::max<int64_t>(1, move_time_ms / 2);
+  limits.hard_time_ms = std::max<int64_t>(1, move_time_ms);
+  return limits;
+}
+
+int64_t SearchShared::elapsed_ms() const {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+static double seconds_since(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+
+bool SearchThread::should_stop() {
+  if (id == 0 && shared.hard_time_ms > 0 &&
+      shared.elapsed_ms() >= shared.hard_time_ms) {
+    shared.stop = true;
+  }
+  if (id == 0 && shared.node_limit > 0 &&
+      nodes.load(std::memory_order_relaxed) >= shared.node_limit) {
+    shared.stop = true;
+  }
+  if (id == 0 && shared.external_stop &&
+      shared.external_stop->load(std::memory_order_relaxed)) {
+    shared.stop = true;
+  }
+  return shared.stop.load(std::memory_order_relaxed);
+}
+
+bool SearchThread::count_node() {
+  // a plain load and store rather than fetch_add, nobody else writes it
+  uint64_t n = nodes.load(std::memory_order_relaxed) + 1;
+  nodes.store(n, std::memory_order_relaxed);
+  return (n & 1023) == 0;
+}
+
+// mate scores are stored relative to the node rather than the root, so the
+// same entry is right wherever the position turns up in the tree
+static int score_to_tt(int score, int ply) {
+  if (score > MATE_BOUND) {
+    return score + ply;
+  }
+  if (score < -MATE_BOUND) {
+    return score - ply;
+  }
+  return score;
+}
+
+static int score_from_tt(int score, int ply) {
+  if (score > MATE_BOUND) {
+    return score - ply;
+  }
+  if (score < -MATE_BOUND) {
+    return score + ply;
+  }
+  return score;
+}
+
+// moves the hash move (if it is in the list) to the front so it is searched
+// first
+static void order_hash_move(MoveList &moves, Move hash_move) {
+  for (int i = 0; i < moves.size(); ++i) {
+    if (moves[i] == hash_move) {
+      std::rotate(moves.begin(), moves.begin() + i, moves.begin() + i + 1);
+      return;
+    }
+  }
+}
+
+// ordering bands, each one is above anything the band below can score
+constexpr int HASH_MOVE_SCORE = 1000000;
+constexpr int CAPTURE_SCORE = 500000;
+constexpr int FIRST_KILLER_SCORE = 400000;
+constexpr int SECOND_KILLER_SCORE = 300000;
+constexpr int HISTORY_MAX = 200000;
+
+// null move pruning from this depth, searching the null move this much
+// shallower (plus a ply for every NULL_MOVE_DEPTH_STEP of depth)
+constexpr int NULL_MOVE_MIN_DEPTH = 3;
+constexpr int NULL_MOVE_REDUCTION = 3;
+constexpr int NULL_MOVE_DEPTH_STEP = 6;
+
+// futility pruning at the last few plies, margins by remaining depth
+constexpr int FUTILITY_DEPTH = 3;
+constexpr int futility_margin[FUTILITY_DEPTH + 1] = {0, 150, 300, 450};
+constexpr int REVERSE_FUTILITY_MARGIN = 120; // per ply of depth
+
+// late move reductions from this depth, for quiet moves after this many
+constexpr int LMR_MIN_DEPTH = 3;
+constexpr int LMR_MIN_MOVES = 3;
+
+// the first aspiration window is the last iteration's score plus or minus
+// this, from this depth on
+constexpr int ASPIRATION_WINDOW = 25;
+constexpr int ASPIRATION_MIN_DEPTH = 4;
+
+// [depth][move number] plies to reduce, growing with the log of both
+static int lmr_table[MAX_PLY][MAX_MOVES];
+
+static bool build_lmr_table() {
+  for (int d = 1; d < MAX_PLY; ++d) {
+    for (int m = 1; m < MAX_MOVES; ++m) {
+      lmr_table[d][m] = (int)(0.75 + std::log(d) * std::log(m) / 2.25);
+    }
+  }
+  return true;
+}
+
+bool is_mate_score(int score) { return std::abs(score) >= MATE_BOUND; }
+
+int tb_score(int wdl, int plies, int ply) {
+  if (wdl == 0) {
+    return 0;
+  }
+  return wdl > 0 ? CHECKMATE_SCORE - ply - plies
+                 : -CHECKMATE_SCORE + ply + plies;
+}
+
+// pawns and king only, where passing is often the best move and null move
+// pruning would be wrong
+static bool only_pawns_left(const Board &board) {
+  int first = board.side_to_move == WHITE ? W_PAWN : B_PAWN;
+  return !(board.piece_bb[first + W_KNIGHT] |
+           board.piece_bb[first + W_BISHOP] | board.piece_bb[first + W_ROOK] |
+           board.piece_bb[first + W_QUEEN]);
+}
+
+// piece type 0-5 (pawn to king), EMPTY counts as a pawn for en passant
+static int piece_type(Piece p) { return p == EMPTY ? 0 : p % 6; }
+
+void SearchThread::score_moves(const MoveList &moves, int scores[],
+                               Move hash_move, int ply) const {
+  for (int i = 0; i < moves.size(); ++i) {
+    Move m = moves[i];
+    if (m == hash_move) {
+      scores[i] = HASH_MOVE_SCORE;
+    } else if (m.is_capture() || m.is_promotion()) {
+      // most valuable victim first, then least valuable attacker
+      int victim = piece_type(board.pieces[m.to()]);
+      int attacker = piece_type(board.pieces[m.from()]);
+      scores[i] = CAPTURE_SCORE + victim * 16 - attacker;
+      if (m.is_promotion()) {
+        scores[i] += piece_type(m.promotion_piece(WHITE)) * 16;
+      }
+    } else if (m == stack[ply].killers[0]) {
+      scores[i] = FIRST_KILLER_SCORE;
+    } else if (m == stack[ply].killers[1]) {
+      scores[i] = SECOND_KILLER_SCORE;
+    } else {
+      scores[i] = history[board.side_to_move][m.from()][m.to()];
+    }
+  }
+}
+
+// swaps the best scoring move from index on into index, a full sort would be
+// wasted whenever an early move cuts off
+static void pick_move(MoveList &moves, int scores[], int index) {
+  int best = index;
+  for (int i = index + 1; i < moves.size(); ++i) {
+    if (scores[i] > scores[best]) {
+      best = i;
+    }
+  }
+  std::swap(moves[index], moves[best]);
+  std::swap(scores[index], scores[best]);
+}
+
+void SearchThread::update_quiet_stats(Move m, int depth, int ply) {
+  if (stack[ply].killers[0] != m) {
+    stack[ply].killers[1] = stack[ply].killers[0];
+    stack[ply].killers[0] = m;
+  }
+
+  int &h = history[board.side_to_move][m.from()][m.to()];
+  h += depth * depth;
+
+  // keep history below the killer band, halving keeps the relative order
+  if (h > HISTORY_MAX) {
+    for (auto &side : history) {
+      for (auto &from : side) {
+        for (int &to : from) {
+          to /= 2;
+        }
+      }
+    }
+  }
+}
+
+void SearchThread::update_pv(int ply, Move m) {
+  SearchStack &node = stack[ply];
+  const SearchStack &child = stack[ply + 1];
+  node.pv[0] = m;
+  std::copy(child.pv, child.pv + child.pv_length, node.pv + 1);
+  node.pv_length = child.pv_length + 1;
+}
+
+int SearchThread::negamax(int depth, int ply, int alpha, int beta) {
+  stack[ply].pv_length = 0;
+  if (count_node() && should_stop()) {
+    return 0;
+  }
+
+  // a window wider than null is one the PV can still run through
+  bool pv_node = beta - alpha > 1;
+
+  // A position seen before in this search is a draw the first time it comes
+  // back, since a line that repeats once can repeat again, so cycles end here
+  // rather than being searched round and round. One from the game before the
+  // root has to make a real threefold repetition. negamax is never the root,
+  // which has to find a move whatever the history says.
+  if (board.is_search_repetition(ply) || board.is_fifty_move_draw()) {
+    return 0;
+  }
+
+  // a tablebase position has its exact score, there is nothing to search
+  if (ply > 0 && popcount(board.occupied) <= tb_max_pieces) {
+    int wdl, plies;
+    if (tb_probe(board, wdl, plies)) {
+      STAT(tb_hits);
+      return tb_score(wdl, plies, ply);
+    }
+  }
+
+  TTEntry entry;
+  bool tt_hit = table.probe(board.hash_key, entry);
+  STAT(tt_probes);
+  if (tt_hit) {
+    STAT(tt_hits);
+  }
+
+  // not at PV nodes, where the cutoff would cut the PV short
+  if (!pv_node && tt_hit && entry.depth >= depth) {
+    int tt_score = score_from_tt(entry.score, ply);
+    if (entry.bound == BOUND_EXACT ||
+        (entry.bound == BOUND_LOWER && tt_score >= beta) ||
+        (entry.bound == BOUND_UPPER && tt_score <= alpha)) {
+      STAT(tt_cutoffs);
+      return tt_score;
+    }
+  }
+
+  if (depth == 0 || ply >= MAX_PLY) {
+    return quiescence(ply, alpha, beta);
+  }
+
+  const SearchOptions &options = shared.options;
+  bool in_check = board.is_in_check();
+  int static_eval = in_check ? -INFINITY_SCORE
+                             : board.evaluate() *
+                                   (board.side_to_move == WHITE ? 1 : -1);
+
+  // so far above beta that even losing a margin per ply won't bring it back
+  if (options.futility && !pv_node && !in_check && depth <= FUTILITY_DEPTH &&
+      !is_mate_score(beta) &&
+      static_eval - REVERSE_FUTILITY_MARGIN * depth >= beta) {
+    STAT(reverse_futility_prunes);
+    return static_eval;
+  }
+
+  // if passing still holds beta, a real move will too. Not twice in a row,
+  // and not with only pawns, where having to move can be what loses.
+  stack[ply].null_move = false;
+  if (options.null_move && !pv_node && !in_check &&
+      depth >= NULL_MOVE_MIN_DEPTH &&
+      static_eval >= beta && !stack[ply - 1].null_move &&
+      !only_pawns_left(board)) {
+    int reduction = NULL_MOVE_REDUCTION + depth / NULL_MOVE_DEPTH_STEP;
+    STAT(null_move_tries);
+    stack[ply].null_move = true;
+    stack[ply + 1].on_pv = false;
+    board.make_null_move();
+    int score = -negamax(std::max(0, depth - 1 - reduction), ply + 1, -beta,
+                         -beta + 1);
+    board.unmake_null_move();
+    stack[ply].null_move = false;
+
+    if (shared.stop.load(std::memory_order_relaxed)) {
+      return 0;
+    }
+    if (score >= beta) {
+      STAT(null_move_cutoffs);
+      // a mate found after passing isn't a real one
+      return is_mate_score(score) ? beta : score;
+    }
+  }
+
+  MoveList moves;
+  board.generate_legal_moves(moves);
+  STAT(movegen_calls);
+  STAT_ADD(moves_generated, moves.size());
+
+  if (moves.empty()) {
+    if (in_check) {
+      return -CHECKMATE_SCORE + ply;
+    } else {
+      return 0;
+    }
+  }
+
+  // along the last iteration's PV its move goes first, even if the table
+  // has lost it
+  Move pv_move = stack[ply].on_pv && ply < pv_length ? pv[ply] : Move();
+  Move hash_move = tt_hit ? entry.best_move : Move();
+  int *scores = stack[ply].scores;
+  score_moves(moves, scores, pv_move.is_none() ? hash_move : pv_move, ply);
+
+  // quiet moves can't close the gap to alpha this close to the horizon
+  bool futile = options.futility && !pv_node && !in_check &&
+                depth <= FUTILITY_DEPTH && !is_mate_score(alpha) &&
+                static_eval + futility_margin[depth] <= alpha;
+
+  int original_alpha = alpha;
+  int best_score = -INFINITY_SCORE;
+  Move best;
+
+  for (int i = 0; i < moves.size(); ++i) {
+    pick_move(moves, scores, i);
+    Move m = moves[i];
+    bool quiet = !m.is_capture() && !m.is_promotion();
+
+    // killers and the hash move score above the history band
+    bool late =
+        quiet && i >= LMR_MIN_MOVES && scores[i] < SECOND_KILLER_SCORE;
+
+    board.make_move(m);
+    bool gives_check = board.is_in_check();
+
+    if (futile && quiet && i > 0 && !gives_check) {
+      STAT(futility_prunes);
+      board.unmake_move(m);
+      continue;
+    }
+
+    int reduction = 0;
+    if (options.late_move_reductions && late && depth >= LMR_MIN_DEPTH &&
+        !in_check && !gives_check) {
+      reduction = std::min(lmr_table[depth][i], depth - 2);
+    }
+    if (reduction > 0) {
+      STAT(lmr_reductions);
+    }
+
+    stack[ply + 1].on_pv = !pv_move.is_none() && m == pv_move;
+
+    // Principal variation search: the first move gets the full window, the
+    // rest only have to show with a null window that they are no better.
+    // One that is better is searched again unreduced, and then with the
+    // full window if it might be the new best move.
+    int score;
+    if (i == 0) {
+      score = -negamax(depth - 1, ply + 1, -beta, -alpha);
+    } else {
+      score = -negamax(depth - 1 - reduction, ply + 1, -alpha - 1, -alpha);
+      if (score > alpha && reduction > 0) {
+        STAT(lmr_researches);
+        score = -negamax(depth - 1, ply + 1, -alpha - 1, -alpha);
+      }
+      if (score > alpha && score < beta) {
+        STAT(pvs_researches);
+        score = -negamax(depth - 1, ply + 1, -beta, -alpha);
+      }
+    }
+
+    board.unmake_move(m);
+
+    // the score of a stopped search is garbage, don't let it reach the table
+    if (shared.stop.load(std::memory_order_relaxed)) {
+      return 0;
+    }
+
+    if (score > best_score) {
+      best_score = score;
+      best = m;
+    }
+    if (score > alpha) {
+      alpha = score;
+      update_pv(ply, m);
+      if (alpha >= beta) {
+        STAT(beta_cutoffs);
+        if (i == 0) {
+          STAT(first_move_cutoffs);
+        }
+        if (quiet) {
+          update_quiet_stats(m, depth, ply);
+        }
+        break;
+      }
+    }
+  }
+
+  Bound bound = BOUND_EXACT;
+  if (best_score <= original_alpha) {
+    bound = BOUND_UPPER;
+    best = Move();
+  } else if (best_score >= beta) {
+    bound = BOUND_LOWER;
+  }
+  table.store(board.hash_key, depth, bound, score_to_tt(best_score, ply), best);
+
+  return best_score;
+}
+
+int SearchThread::quiescence(int ply, int alpha, int beta) {
+  STAT(qnodes);
+  if (count_node() && should_stop()) {
+    return 0;
+  }
+
+  int static_eval = board.evaluate() * (board.side_to_move == WHITE ? 1 : -1);
+  if (ply >= MAX_PLY) {
+    return static_eval;
+  }
+
+  // In check every evasion has to be tried and standing pat is not an
+  // option. Otherwise the side to move can decline to capture, so the static
+  // eval is a lower bound.
+  bool in_check = board.is_in_check();
+  MoveList moves;
+  int best_score;
+  if (in_check) {
+    board.generate_legal_moves(moves);
+    if (moves.empty()) {
+      return -CHECKMATE_SCORE + ply;
+    }
+    best_score = -INFINITY_SCORE;
+  } else {
+    if (static_eval >= beta) {
+      return static_eval;
+    }
+    alpha = std::max(alpha, static_eval);
+    best_score = static_eval;
+    board.generate_legal_captures(moves);
+  }
+  STAT(movegen_calls);
+  STAT_ADD(moves_generated, moves.size());
+
+  int *scores = stack[ply].scores;
+  score_moves(moves, scores, Move(), ply);
+
+  for (int i = 0; i < moves.size(); ++i) {
+    pick_move(moves, scores, i);
+    Move m = moves[i];
+
+    // a capture that loses material on the exchange won't raise alpha
+    if (!in_check && !m.is_promotion() && board.see(m) < 0) {
+      STAT(see_prunes);
+      continue;
+    }
+
+    board.make_move(m);
+    int score = -quiescence(ply + 1, -beta, -alpha);
+    board.unmake_move(m);
+
+    if (shared.stop.load(std::memory_order_relaxed)) {
+      return 0;
+    }
+
+    if (score > best_score) {
+      best_score = score;
+      alpha = std::max(alpha, score);
+      if (alpha >= beta) {
+        break;
+      }
+    }
+  }
+
+  return best_score;
+}
+
+bool SearchThread::search_root(int depth, int alpha, int beta, int &score) {
+  stack[0].pv_length = 0;
+  MoveList moves;
+  board.generate_legal_moves(moves);
+  auto is_excluded = [this](Move m) {
+    return std::find(excluded.begin(), excluded.end(), m) != excluded.end();
+  };
+  moves.count = std::remove_if(moves.begin(), moves.end(), is_excluded) -
+                moves.begin();
+
+  TTEntry entry;
+  bool tt_hit = table.probe(board.hash_key, entry);
+
+  // the last iteration's move for this line first, then the same as any
+  // other node
+  Move pv_move = pv_length > 0 ? pv[0] : Move();
+  Move hash_move = tt_hit ? entry.best_move : Move();
+  int *scores = stack[0].scores;
+  score_moves(moves, scores, pv_move.is_none() ? hash_move : pv_move, 0);
+
+  int original_alpha = alpha;
+  int best_score = -INFINITY_SCORE;
+  Move best;
+
+  for (int i = 0; i < moves.size(); ++i) {
+    pick_move(moves, scores, i);
+    Move m = moves[i];
+
+    board.make_move(m);
+    stack[1].on_pv = !pv_move.is_none() && m == pv_move;
+
+    int move_score;
+    if (i == 0) {
+      move_score = -negamax(depth - 1, 1, -beta, -alpha);
+    } else {
+      move_score = -negamax(depth - 1, 1, -alpha - 1, -alpha);
+      if (move_score > alpha && move_score < beta) {
+        STAT(pvs_researches);
+        move_score = -negamax(depth - 1, 1, -beta, -alpha);
+      }
+    }
+
+    board.unmake_move(m);
+
+    if (shared.stop.load(std::memory_order_relaxed)) {
+      return false;
+    }
+
+    if (move_score > best_score) {
+      best_score = move_score;
+      best = m;
+    }
+    if (move_score > alpha) {
+      alpha = move_score;
+      update_pv(0, m);
+      if (alpha >= beta) {
+        break;
+      }
+    }
+  }
+
+  // with moves left out the score isn't the position's, only the first line
+  // is worth keeping
+  if (excluded.empty()) {
+    Bound bound = BOUND_EXACT;
+    if (best_score <= original_alpha) {
+      bound = BOUND_UPPER;
+      best = Move();
+    } else if (best_score >= beta) {
+      bound = BOUND_LOWER;
+    }
+    table.store(board.hash_key, depth, bound, score_to_tt(best_score, 0),
+                best);
+  }
+
+  score = best_score;
+  return true;
+}
+
+// Searches the root with a window around expected, which is the score of the
+// same line last iteration. The score rarely moves far from one iteration to
+// the next, and a narrow window cuts off more. A score outside it is only a
+// bound, so that side of the window is widened and the depth searched again.
+bool SearchThread::aspiration_search(int depth, const PvLine *expected,
+                                     int &score) {
+  int delta = ASPIRATION_WINDOW;
+  int alpha = -INFINITY_SCORE;
+  int beta = INFINITY_SCORE;
+  if (expected && depth >= ASPIRATION_MIN_DEPTH &&
+      !is_mate_score(expected->score)) {
+    alpha = std::max(-INFINITY_SCORE, expected->score - delta);
+    beta = std::min(INFINITY_SCORE, expected->score + delta);
+  }
+
+  while (true) {
+    if (!search_root(depth, alpha, beta, score)) {
+      return false;
+    }
+    if (score <= alpha && alpha > -INFINITY_SCORE) {
+      beta = (alpha + beta) / 2;
+      alpha = std::max(-INFINITY_SCORE, score - delta);
+    } else if (score >= beta && beta < INFINITY_SCORE) {
+      beta = std::min(INFINITY_SCORE, score + delta);
+    } else {
+      return true;
+    }
+    STAT(aspiration_researches);
+    delta *= 2;
+  }
+}
+
+void SearchThread::iterate(int max_depth) {
+  static const bool lmr_ready = build_lmr_table();
+  (void)lmr_ready;
+  stack[0].null_move = false;
+  stack[0].on_pv = true;
+
+  MoveList root_moves;
+  board.generate_legal_moves(root_moves);
+  int line_count = std::min(shared.multi_pv, root_moves.size());
+
+  int start_depth = (id % 2 == 1) ? 2 : 1;
+  for (int depth = start_depth; depth <= max_depth; ++depth) {
+    // each line is the best move left once the lines before it are taken
+    // out, searched as a root of its own with the same table
+    std::vector<PvLine> found;
+    excluded.clear();
+    for (int index = 0; index < line_count; ++index) {
+      const PvLine *last =
+          index < (int)lines.size() ? &lines[index] : nullptr;
+      pv_length = last ? (int)last->pv.size() : 0;
+      if (last) {
+        std::copy(last->pv.begin(), last->pv.end(), pv);
+      }
+
+      int score;
+      if (!aspiration_search(depth, last, score)) {
+        return;
+      }
+
+      PvLine line;
+      line.score = score;
+      line.pv.assign(stack[0].pv, stack[0].pv + stack[0].pv_length);
+      found.push_back(line);
+      excluded.push_back(line.pv[0]);
+    }
+
+    // a later line can come out ahead when the first search of a move was
+    // cut short by the table or pruning
+    std::stable_sort(found.begin(), found.end(),
+                     [](const PvLine &a, const PvLine &b) {
+                       return a.score > b.score;
+                     });
+    lines = found;
+    best_move = lines[0].pv[0];
+    best_score = lines[0].score;
+    completed_depth = depth;
+    if (id == 0) {
+      IterationStats iteration;
+      iteration.depth = depth;
+      iteration.score = best_score;
+      iteration.nodes = nodes.load(std::memory_order_relaxed);
+      iteration.seconds = seconds_since(shared.start);
+      iterations.push_back(iteration);
+    }
+
+    if (id == 0 && shared.report) {
+      shared.report();
+    }
+
+    // another ply costs several times this one, don't start what we can't
+    // finish
+    if (id == 0 && shared.soft_time_ms > 0 &&
+        shared.elapsed_ms() >= shared.soft_time_ms) {
+      return;
+    }
+  }
+}
+
+SearchResult search(const Board &board, const SearchLimits &limits,
+                    TranspositionTable &table) {
+  // mated or stalemated: nothing to search and no move to return
+  MoveList root_moves;
+  board.generate_legal_moves(root_moves);
+  if (root_moves.empty()) {
+    SearchResult result;
+    result.score = board.is_in_check() ? -CHECKMATE_SCORE : 0;
+    return result;
+  }
+
+  SearchShared shared;
+  shared.start = std::chrono::steady_clock::now();
+  shared.soft_time_ms = limits.soft_time_ms;
+  shared.hard_time_ms = limits.hard_time_ms;
+  shared.node_limit = limits.nodes;
+  shared.options = limits.options;
+  shared.multi_pv = std::max(1, limits.multi_pv);
+  shared.external_stop = limits.stop;
+
+  int thread_count = std::max(1, limits.threads);
+  std::vector<std::unique_ptr<SearchThread>> threads;
+  for (int i = 0; i < thread_count; ++i) {
+    threads.emplace_back(new SearchThread(board, table, shared, i));
+  }
+
+  // progress as of the main thread's last iteration, the helpers are still
+  // running so only their node counts are read
+  if (limits.on_iteration) {
+    shared.report = [&] {
+      const SearchThread &main = *threads[0];
+      SearchResult progress;
+      progress.best_move = main.best_move;
+      progress.score = main.best_score;
+      progress.depth = main.completed_depth;
+      for (const auto &t : threads) {
+        progress.nodes += t->nodes.load(std::memory_order_relaxed);
+      }
+      progress.seconds = seconds_since(shared.start);
+      progress.lines = main.lines;
+      progress.pv = main.lines[0].pv;
+      limits.on_iteration(progress);
+    };
+  }
+
+  // helpers keep deepening until the main thread reaches the target depth,
+  // their value is the table entries they leave behind
+  std::vector<std::thread> helpers;
+  for (int i = 1; i < thread_count; ++i) {
+    SearchThread *t = threads[i].get();
+    helpers.emplace_back([t] { t->iterate(MAX_PLY - 1); });
+  }
+
+  threads[0]->iterate(std::max(1, limits.depth));
+  shared.stop = true;
+  for (std::thread &h : helpers) {
+    h.join();
+  }
+
+  // a helper that finished a deeper iteration than the main thread has the
+  // better move
+  SearchResult result;
+  const SearchThread *best = threads[0].get();
+  for (const auto &t : threads) {
+    result.nodes += t->nodes;
+    result.pawn_probes += t->pawn_table.probes;
+    result.pawn_hits += t->pawn_table.hits;
+    result.stats += t->stats;
+    if (t->completed_depth > best->completed_depth) {
+      best = t.get();
+    }
+  }
+
+  result.best_move = best->best_move;
+  result.score = best->best_score;
+  result.depth = best->completed_depth;
+  result.iterations = threads[0]->iterations;
+  result.lines = best->lines;
+  if (!result.lines.empty()) {
+    result.pv = result.lines[0].pv;
+  }
+
+  // out of time before depth 1 finished, any legal move beats none
+  if (result.depth == 0) {
+    TTEntry entry;
+    if (table.probe(board.hash_key, entry)) {
+      order_hash_move(root_moves, entry.best_move);
+    }
+    result.best_move = root_moves[0];
+    result.pv.assign(1, root_moves[0]);
+    result.lines.assign(1, PvLine{0, result.pv});
+  }
+
+  result.seconds = seconds_since(shared.start);
+  return result;
+}
+
+static double ratio(uint64_t part, uint64_t whole) {
+  return whole > 0 ? (double)part / whole : 0;
+}
+
+std::string search_stats_json(const SearchResult &result) {
+  const SearchStats &s = result.stats;
+
+  // nodes of the last iteration over those of the one before, what one more
+  // ply costs
+  double branching_factor = 0;
+  size_t n = result.iterations.size();
+  if (n >= 2) {
+    uint64_t last =
+        result.iterations[n - 1].nodes - result.iterations[n - 2].nodes;
+    uint64_t before = result.iterations[n - 2].nodes -
+                      (n >= 3 ? result.iterations[n - 3].nodes : 0);
+    branching_factor = ratio(last, before);
+  }
+
+  std::ostringstream out;
+  out << "{\"depth\":" << result.depth << ",\"score\":" << result.score
+      << ",\"nodes\":" << result.nodes << ",\"nps\":"
+      << (uint64_t)(result.nodes / std::max(result.seconds, 0.001))
+      << ",\"time_ms\":" << (int64_t)(result.seconds * 1000)
+      << ",\"branching_factor\":" << branching_factor
+      << ",\"pawn_hit_rate\":" << ratio(result.pawn_hits, result.pawn_probes)
+      << ",\"stats_enabled\":" << (stats_enabled ? "true" : "false")
+      << ",\"tt_hit_rate\":" << ratio(s.tt_hits, s.tt_probes)
+      << ",\"first_move_cutoff_rate\":"
+      << ratio(s.first_move_cutoffs, s.beta_cutoffs)
+      << ",\"null_move_cutoff_rate\":"
+      << ratio(s.null_move_cutoffs, s.null_move_tries)
+      << ",\"moves_per_movegen\":" << ratio(s.moves_generated, s.movegen_calls);
+
+  const std::pair<const char *, uint64_t> counters[] = {
+      {"qnodes", s.qnodes},
+      {"tt_probes", s.tt_probes},
+      {"tt_hits", s.tt_hits},
+      {"tt_cutoffs", s.tt_cutoffs},
+      {"tb_hits", s.tb_hits},
+      {"beta_cutoffs", s.beta_cutoffs},
+      {"first_move_cutoffs", s.first_move_cutoffs},
+      {"null_move_tries", s.null_move_tries},
+      {"null_move_cutoffs", s.null_move_cutoffs},
+      {"lmr_reductions", s.lmr_reductions},
+      {"lmr_researches", s.lmr_researches},
+      {"pvs_researches", s.pvs_researches},
+      {"futility_prunes", s.futility_prunes},
+      {"reverse_futility_prunes", s.reverse_futility_prunes},
+      {"see_prunes", s.see_prunes},
+      {"aspiration_researches", s.aspiration_researches},
+      {"movegen_calls", s.movegen_calls},
+      {"moves_generated", s.moves_generated},
+  };
+  out << ",\"counters\":{";
+  for (size_t i = 0; i < std::size(counters); ++i) {
+    out << (i > 0 ? "," : "") << '"' << counters[i].first
+        << "\":" << counters[i].second;
+  }
+
+  out << "},\"iterations\":[";
+  for (size_t i = 0; i < n; ++i) {
+    const IterationStats &it = result.iterations[i];
+    out << (i > 0 ? "," : "") << "{\"depth\":" << it.depth
+        << ",\"score\":" << it.score << ",\"nodes\":" << it.nodes
+        << ",\"time_ms\":" << (int64_t)(it.seconds * 1000) << '}';
+  }
+  out << "]}";
+  return out.str();
+}
@@ -0,0 +1,242 @@
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include "board.h"
+#include "move.h"
+#include "pawns.h"
+#include "stats.h"
+#include "tt.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+constexpr int INFINITY_SCORE = 1000000;
+constexpr int CHECKMATE_SCORE = 999999;
+
+// deepest ply a search can reach
+constexpr int MAX_PLY = 128;
+
+// Scores beyond MATE_BOUND (or below -MATE_BOUND) are mates. A mate the
+// search finds is at most MAX_PLY plies away, but a tablebase win probed at
+// a deep ply adds the table's own distance to mate on top, up to 253 plies.
+constexpr int MATE_BOUND = CHECKMATE_SCORE - 2 * MAX_PLY - 256;
+
+// The selective parts of the search, each can be switched off on its own to
+// measure what it is worth
+struct SearchOptions {
+  // give the opponent a free move with a reduced search, if we are still
+  // above beta the real moves will be too
+  bool null_move = true;
+
+  // search quiet moves ordered late to a reduced depth, and only search
+  // them again fully if they beat alpha
+  bool late_move_reductions = true;
+
+  // near the horizon, skip quiet moves when the static eval is far below
+  // alpha, and return at once when it is far above beta
+  bool futility = true;
+};
+
+struct SearchLimits {
+  int depth = MAX_PLY - 1;
+
+  // Time limits in milliseconds, 0 means none. No new iteration is started
+  // once soft_time_ms has passed, and the search in progress is abandoned at
+  // hard_time_ms.
+  int64_t soft_time_ms = 0;
+  int64_t hard_time_ms = 0;
+
+  // stop once the main thread has searched this many nodes, 0 means no limit
+  uint64_t nodes = 0;
+
+  int threads = 1;
+
+  // how many of the best root moves get an exact score and a line. Each
+  // line after the first is searched with the root moves of the ones before
+  // it left out.
+  int multi_pv = 1;
+
+  SearchOptions options;
+
+  // set by the caller to abandon the search from outside (UCI "stop"), may
+  // be null
+  const std::atomic<bool> *stop = nullptr;
+
+  // called by the main search thread after every finished iteration, for
+  // progress output such as UCI info lines. May be empty.
+  std::function<void(const struct SearchResult &)> on_iteration;
+};
+
+// Limits for spending roughly move_time_ms on a move: stop deepening at half
+// the budget, since the next iteration would likely not finish, and never go
+// past the full budget
+SearchLimits time_limits(int64_t move_time_ms);
+
+// a line from the root with its score, the move first
+struct PvLine {
+  int score = 0;
+  std::vector<Move> pv;
+};
+
+struct SearchResult {
+  Move best_move;
+  int score = 0;
+  int depth = 0;       // deepest iteration that finished
+  uint64_t nodes = 0;  // summed over every thread
+  double seconds = 0;
+  std::vector<Move> pv; // best_move then the expected replies
+
+  // the multi_pv best lines (fewer if there aren't as many legal moves),
+  // best first, lines[0] is best_move, score and pv again
+  std::vector<PvLine> lines;
+
+  // pawn structure cache lookups and hits, summed over every thread
+  uint64_t pawn_probes = 0;
+  uint64_t pawn_hits = 0;
+
+  // the main thread's finished iterations, and the counters of every thread
+  // (all zero unless built with SEARCH_STATS)
+  std::vector<IterationStats> iterations;
+  SearchStats stats;
+};
+
+// Per-ply scratch space, allocated once with the thread so nodes don't need
+// any of their own
+struct SearchStack {
+  Move killers[2];       // quiet moves that caused a cutoff at this ply
+  bool null_move;        // the move played from this ply was a null move
+  bool on_pv;            // every move to here was on the last iteration's PV
+  int scores[MAX_MOVES]; // ordering scores of the moves being searched
+
+  // the best line found from this ply on, the triangular PV table: each ply
+  // copies the line of the ply below behind its own best move
+  Move pv[MAX_PLY];
+  int pv_length;
+};
+
+// what the threads of one search have in common besides the table
+struct SearchShared {
+  std::atomic<bool> stop{false};
+  std::chrono::steady_clock::time_point start;
+  int64_t soft_time_ms = 0;
+  int64_t hard_time_ms = 0;
+  uint64_t node_limit = 0;
+  const std::atomic<bool> *external_stop = nullptr;
+  SearchOptions options;
+  int multi_pv = 1;
+
+  // called by the main thread when it finishes an iteration, may be empty
+  std::function<void()> report;
+
+  int64_t elapsed_ms() const;
+};
+
+// state owned by one search thread, it searches its own copy of the board
+// and only talks to the other threads through the transposition table
+struct SearchThread {
+  Board board;
+  TranspositionTable &table;
+  SearchShared &shared;
+  int id;
+
+  // only this thread writes it, the main thread reads it for progress
+  // reports while the search runs
+  std::atomic<uint64_t> nodes{0};
+  Move best_move;
+  int best_score = 0;
+  int completed_depth = 0;
+
+  // the best lines of the last finished iteration, best first
+  std::vector<PvLine> lines;
+
+  // the line the search in progress follows, the last iteration's line for
+  // the same multi-PV slot, whose moves are searched first
+  Move pv[MAX_PLY];
+  int pv_length = 0;
+
+  // root moves that already have a line in this iteration
+  std::vector<Move> excluded;
+
+  // one more than MAX_PLY, a node at the last ply still clears the one below
+  SearchStack stack[MAX_PLY + 1];
+  int history[2][64][64]{}; // [side][from][to] cutoff credit for quiet moves
+
+  // board's evaluate() caches pawn structure here
+  PawnTable pawn_table;
+
+  SearchStats stats;
+  std::vector<IterationStats> iterations;
+
+  SearchThread(const Board &root, TranspositionTable &table,
+               SearchShared &shared, int id)
+      : board(root), table(table), shared(shared), id(id) {
+    board.pawn_table = &pawn_table;
+    // every move of the search pushes one entry, none of them reallocate
+    board.history.reserve(board.history.size() + MAX_PLY + 1);
+  }
+
+  // iterative deepening from depth 1 (or 2 for odd helper threads, so they
+  // spread out over the tree) until max_depth, the soft time limit or until
+  // stop is set
+  void iterate(int max_depth);
+
+  // polled every 1024 nodes, the main thread also enforces the hard deadline
+  // and the caller's stop flag
+  bool should_stop();
+
+  // counts a node, true if it is time to poll should_stop()
+  bool count_node();
+
+  // One pass over the root moves not in excluded with an (alpha, beta)
+  // window, false if it was stopped. There is always a move left: search()
+  // doesn't start on a position without any, and iterate() asks for no more
+  // lines than there are moves. score is outside the window if the search
+  // failed low or high, and only a bound then.
+  bool search_root(int depth, int alpha, int beta, int &score);
+
+  // search_root with aspiration windows around the score expected for the
+  // line (none for a full window), false if it was stopped
+  bool aspiration_search(int depth, const PvLine *expected, int &score);
+
+  int negamax(int depth, int ply, int alpha, int beta);
+
+  // captures only search below the horizon, so leaves are never scored in
+  // the middle of an exchange
+  int quiescence(int ply, int alpha, int beta);
+
+  // Gives every move an ordering score: hash move, then captures by
+  // MVV-LVA, then killers, then quiet moves by history
+  void score_moves(const MoveList &moves, int scores[],
+                   Move hash_move, int ply) const;
+
+  // credit a quiet move that caused a beta cutoff
+  void update_quiet_stats(Move m, int depth, int ply);
+
+  // m raised alpha at ply: it and the line below it become the ply's PV
+  void update_pv(int ply, Move m);
+};
+
+// true for a score beyond the mate bound on either side
+bool is_mate_score(int score);
+
+// The score of a tablebase probe ply plies below the root: wdl and plies as
+// tb_probe gives them, a win or loss scored as a mate plies further on.
+int tb_score(int wdl, int plies, int ply);
+
+// Searches the position with limits.threads threads sharing table (Lazy
+// SMP) and returns the best move of the deepest finished iteration. There is
+// always a move if the position has one, even if no iteration finished. A
+// mated or stalemated position comes back at once with no move, no lines,
+// depth 0 and a score of -CHECKMATE_SCORE or 0.
+SearchResult search(const Board &board, const SearchLimits &limits,
+                    TranspositionTable &table);
+
+// The result as a single line JSON record: nodes, time, effective branching
+// factor, table and cutoff rates, every counter and every iteration. For
+// dashboards that track search behaviour from build to build.
+std::string search_stats_json(const SearchResult &result);
+
+#endif
@@ -0,0 +1,285 @@
+#include "selftest.h"
+#include "board.h"
+#include "book.h"
+#include "epd.h"
+#include "move.h"
+#include "search.h"
+#include "tablebase.h"
+#include "tt.h"
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+
+using std::cout;
+
+// searches fen with the given threads and lines, true if there was nothing
+// to search: no move, no lines, depth 0 and the expected score
+static bool searches_terminal(const char *fen, int expected_score,
+                              int threads, int multi_pv) {
+  Board board;
+  if (!board.set_fen(fen)) {
+    return false;
+  }
+  TranspositionTable table;
+  table.resize(1);
+  SearchLimits limits;
+  limits.depth = 4;
+  limits.threads = threads;
+  limits.multi_pv = multi_pv;
+  SearchResult result = search(board, limits, table);
+  return result.best_move.is_none() && result.lines.empty() &&
+         result.pv.empty() && result.depth == 0 &&
+         result.score == expected_score;
+}
+
+static bool search_mated() {
+  const char *fen = "7k/6Q1/6K1/8/8/8/8/8 b - - 0 1";
+  return searches_terminal(fen, -CHECKMATE_SCORE, 1, 1) &&
+         searches_terminal(fen, -CHECKMATE_SCORE, 2, 3);
+}
+
+static bool search_stalemated() {
+  const char *fen = "7k/5Q2/6K1/8/8/8/8/8 b - - 0 1";
+  return searches_terminal(fen, 0, 1, 1) && searches_terminal(fen, 0, 2, 3);
+}
+
+// FENs of positions that can't come up in a game, which set_fen refuses
+static bool fen_rejects_illegal() {
+  const char *fens[] = {
+      "4k3/4Q3/8/8/8/8/8/4K3 w - - 0 1", // black in check, white to move
+      "4k3/8/8/8/8/8/4r3/4K3 b - - 0 1", // white in check, black to move
+      "4k2P/8/8/8/8/8/8/4K3 w - - 0 1",  // pawn on the last rank
+      "4k3/8/8/8/8/8/8/p3K3 b - - 0 1",  // pawn on the first rank
+  };
+  for (const char *fen : fens) {
+    Board board;
+    if (board.set_fen(fen)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// a FEN's en passant square is only kept in front of a pawn that could just
+// have made a double push past it
+static bool fen_en_passant_square() {
+  struct EnPassantCheck {
+    const char *fen;
+    int square;
+  };
+  const EnPassantCheck checks[] = {
+      {"4k3/8/8/3pP3/8/8/8/4K3 w - d6 0 1", 43},
+      {"4k3/8/8/4P3/8/8/8/4K3 w - d6 0 1", -1},    // no pawn on d5
+      {"4k3/8/3n4/3pP3/8/8/8/4K3 w - d6 0 1", -1}, // d6 taken
+      {"4k3/8/8/8/3pP3/8/8/4K3 b - e3 0 1", 20},
+      {"4k3/8/8/8/3pP3/8/8/4K3 w - e3 0 1", -1}, // white just moved
+  };
+  for (const EnPassantCheck &check : checks) {
+    Board board;
+    if (!board.set_fen(check.fen) ||
+        board.en_passant_square != check.square) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// castling rights in a FEN only survive where the king and rook are home
+static bool fen_castling_rights() {
+  struct CastlingCheck {
+    const char *fen;
+    int rights;
+  };
+  const CastlingCheck checks[] = {
+      {"4k3/8/8/8/8/8/8/4K3 w K - 0 1", 0},
+      {"r3k2r/8/8/8/8/8/8/R3K1R1 w KQkq - 0 1", WQ | BK | BQ},
+      {"r3k2r/8/8/8/8/8/8/R4K1R b KQkq - 0 1", BK | BQ},
+      {"1r2k2r/8/8/8/8/8/8/R3K2R w KQkq - 0 1", WK | WQ | BK},
+  };
+  for (const CastlingCheck &check : checks) {
+    Board board;
+    if (!board.set_fen(check.fen) || board.castling_rights != check.rights) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// plays the moves on board, false if one of them isn't legal
+static bool play_moves(Board &board, const char *moves) {
+  std::istringstream in(moves);
+  std::string move_str;
+  while (in >> move_str) {
+    Move move = parse_move(board, move_str);
+    if (move.is_none()) {
+      return false;
+    }
+    board.make_move(move);
+  }
+  return true;
+}
+
+// a position repeated once is a draw for the search only if the earlier one
+// came after the root, one from the game before needs a threefold repetition
+static bool search_repetitions() {
+  Board game;
+  game.set_fen(START_FEN);
+  if (!play_moves(game, "g1f3 g8f6 f3g1 f6g8")) {
+    return false;
+  }
+
+  // the knights go out and back once more below the root
+  Board board = game;
+  if (!play_moves(board, "g1f3") || !board.is_repetition(1) ||
+      board.is_search_repetition(1)) {
+    return false;
+  }
+  if (!play_moves(board, "g8f6 f3g1 f6g8 g1f3") ||
+      !board.is_search_repetition(5)) {
+    return false;
+  }
+
+  // with the game history played from the start the same line is a cycle
+  // the search started itself
+  Board fresh;
+  fresh.set_fen(START_FEN);
+  return play_moves(fresh, "g1f3 g8f6 f3g1 f6g8 g1f3") &&
+         fresh.is_search_repetition(5) && !fresh.is_search_repetition(4);
+}
+
+// result lines of a small EPD input: a playable position gets a "pm", a mated
+// or stalemated one only its score at depth 0, and every line keeps its own
+// operations at the end
+static bool epd_terminal_lines() {
+  struct EpdCheck {
+    const char *line;
+    bool has_move;
+    const char *score; // what "ce ...; acd ...;" has to read, if fixed
+  };
+  const EpdCheck checks[] = {
+      {"4k3/8/8/8/8/8/4P3/4K3 w - - id \"pawn\";", true, nullptr},
+      {"7k/6Q1/6K1/8/8/8/8/8 b - - id \"mated\";", false,
+       " ce -32767; acd 0;"},
+      {"7k/5Q2/6K1/8/8/8/8/8 b - - 0 1 id \"stalemated\";", false,
+       " ce 0; acd 0;"},
+  };
+  TranspositionTable table;
+  table.resize(1);
+  SearchLimits limits;
+  limits.depth = 4;
+  for (const EpdCheck &check : checks) {
+    Board board;
+    if (!board.set_fen(check.line)) {
+      return false;
+    }
+    table.clear();
+    SearchResult result = search(board, limits, table);
+    std::string out = epd_result_line(board, check.line, result);
+    std::string line = check.line;
+    std::string id = line.substr(line.find(" id "));
+    bool has_move = out.find(" pm ") != std::string::npos;
+    if (has_move != check.has_move ||
+        out.compare(out.size() - id.size(), id.size(), id) != 0 ||
+        (check.score && out.find(check.score) == std::string::npos)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// A long tablebase win probed near the bottom of the search: ply and the
+// table's distance to mate together are well past MAX_PLY, and the score
+// still has to count as a mate for either side. The 3 piece tables are
+// generated into a temporary directory first, which takes under a second.
+static bool tablebase_deep_win() {
+  char dir[] = "/tmp/chess_engine_selftest_XXXXXX";
+  if (!mkdtemp(dir)) {
+    return false;
+  }
+  // gentb reports every table it writes, which isn't wanted here
+  std::ostringstream discard;
+  std::streambuf *saved = cout.rdbuf(discard.rdbuf());
+  char pieces_arg[] = "--pieces";
+  char pieces[] = "3";
+  char *args[] = {pieces_arg, pieces, dir};
+  bool passed = gentb_command(3, args) == 0;
+  cout.rdbuf(saved);
+  passed = passed && tb_init(dir) > 0;
+
+  Board board;
+  board.set_fen("4k3/8/8/8/8/8/4P3/4K3 w - - 0 1");
+  int wdl, plies;
+  passed = passed && tb_probe(board, wdl, plies) && wdl == 1 && plies > 40;
+  if (passed) {
+    int ply = MAX_PLY - 1;
+    int win = tb_score(wdl, plies, ply);
+    int loss = tb_score(-wdl, plies, ply);
+    passed = is_mate_score(win) && win > 0 && is_mate_score(loss) && loss < 0;
+  }
+
+  for (const char *name : {"KQK", "KRK", "KBK", "KNK", "KPK"}) {
+    std::remove((std::string(dir) + "/" + name + ".tb").c_str());
+  }
+  tb_init(dir); // finds nothing now, which unloads the tables again
+  rmdir(dir);
+  return passed;
+}
+
+// the example keys from the Polyglot specification, each after playing the
+// moves from the start position
+static bool polyglot_keys() {
+  struct KeyCheck {
+    const char *moves;
+    uint64_t key;
+  };
+  const KeyCheck checks[] = {
+      {"", 0x463b96181691fc9cULL},
+      {"e2e4", 0x823c9b50fd114196ULL},
+      {"e2e4 d7d5", 0x0756b94461c50fb0ULL},
+      {"e2e4 d7d5 e4e5", 0x662fafb965db29d4ULL},
+      {"e2e4 d7d5 e4e5 f7f5", 0x22a48b5a8e47ff78ULL},
+      {"e2e4 d7d5 e4e5 f7f5 e1e2", 0x652a607ca3f242c1ULL},
+      {"e2e4 d7d5 e4e5 f7f5 e1e2 e8f7", 0x00fdd303c946bdd9ULL},
+      {"a2a4 b7b5 h2h4 b5b4 c2c4", 0x3c8123ea7b067637ULL},
+      {"a2a4 b7b5 h2h4 b5b4 c2c4 b4c3 a1a3", 0x5c3f9b829b279560ULL},
+  };
+  for (const KeyCheck &check : checks) {
+    Board board;
+    board.set_fen(START_FEN);
+    if (!play_moves(board, check.moves) || polyglot_key(board) != check.key) {
+      return false;
+    }
+  }
+  return true;
+}
+
+struct SelfTest {
+  const char *name;
+  bool (*run)();
+};
+
+const SelfTest self_tests[] = {
+    {"fens of illegal positions", fen_rejects_illegal},
+    {"en passant squares without a pawn to take", fen_en_passant_square},
+    {"castling rights without their king or rook", fen_castling_rights},
+    {"search of a mated position", search_mated},
+    {"search of a stalemated position", search_stalemated},
+    {"repetitions before and inside the search", search_repetitions},
+    {"epd lines of mated and stalemated positions", epd_terminal_lines},
+    {"tablebase win probed at the deepest ply", tablebase_deep_win},
+    {"polyglot keys of the specification examples", polyglot_keys},
+};
+
+int selftest_command(int, char *[]) {
+  bool all_passed = true;
+  for (const SelfTest &test : self_tests) {
+    bool passed = test.run();
+    all_passed = all_passed && passed;
+    cout << (passed ? "ok   " : "FAIL ") << test.name << '\n';
+  }
+  cout << (all_passed ? "All checks passed\n" : "Some checks FAILED\n");
+  return all_passed ? 0 : 1;
+}
@@ -0,0 +1,9 @@
+#ifndef SELFTEST_H
+#define SELFTEST_H
+
+// Entry point for "chess_engine selftest": runs the regression checks for
+// cases the perft suite can't see (search edge cases, book keys, output
+// formats) and prints ok or FAIL for each. Returns the process exit code.
+int selftest_command(int argc, char *argv[]);
+
+#endif
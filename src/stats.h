@@ -0,0 +1,77 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <cstdint>
+
+// What the search did, counted per thread and summed at the end of a search.
+// The counters are only kept in builds made with "make STATS=1", which
+// defines SEARCH_STATS. Otherwise STAT() expands to nothing and the search
+// code is the same as without them.
+#ifdef SEARCH_STATS
+constexpr bool stats_enabled = true;
+#define STAT(counter) (++stats.counter)
+#define STAT_ADD(counter, n) (stats.counter += (n))
+#else
+constexpr bool stats_enabled = false;
+#define STAT(counter) ((void)0)
+#define STAT_ADD(counter, n) ((void)0)
+#endif
+
+struct SearchStats {
+  uint64_t qnodes = 0; // the part of the node count spent in quiescence
+
+  uint64_t tt_probes = 0;
+  uint64_t tt_hits = 0;
+  uint64_t tt_cutoffs = 0;
+  uint64_t tb_hits = 0;
+
+  // beta cutoffs in negamax, and how many came from the first move searched
+  uint64_t beta_cutoffs = 0;
+  uint64_t first_move_cutoffs = 0;
+
+  uint64_t null_move_tries = 0;
+  uint64_t null_move_cutoffs = 0;
+  uint64_t lmr_reductions = 0;
+  uint64_t lmr_researches = 0; // reduced searches that beat alpha
+  uint64_t pvs_researches = 0; // null windows that needed the full window
+  uint64_t futility_prunes = 0;
+  uint64_t reverse_futility_prunes = 0;
+  uint64_t see_prunes = 0; // captures quiescence skipped
+  uint64_t aspiration_researches = 0;
+
+  uint64_t movegen_calls = 0;
+  uint64_t moves_generated = 0;
+
+  SearchStats &operator+=(const SearchStats &o) {
+    qnodes += o.qnodes;
+    tt_probes += o.tt_probes;
+    tt_hits += o.tt_hits;
+    tt_cutoffs += o.tt_cutoffs;
+    tb_hits += o.tb_hits;
+    beta_cutoffs += o.beta_cutoffs;
+    first_move_cutoffs += o.first_move_cutoffs;
+    null_move_tries += o.null_move_tries;
+    null_move_cutoffs += o.null_move_cutoffs;
+    lmr_reductions += o.lmr_reductions;
+    lmr_researches += o.lmr_researches;
+    pvs_researches += o.pvs_researches;
+    futility_prunes += o.futility_prunes;
+    reverse_futility_prunes += o.reverse_futility_prunes;
+    see_prunes += o.see_prunes;
+    aspiration_researches += o.aspiration_researches;
+    movegen_calls += o.movegen_calls;
+    moves_generated += o.moves_generated;
+    return *this;
+  }
+};
+
+// one finished iteration of the main thread, kept in every build since it
+// costs nothing per node
+struct IterationStats {
+  int depth = 0;
+  int score = 0;
+  uint64_t nodes = 0; // the main thread's, from the start of the search
+  double seconds = 0; // from the start of the search
+};
+
+#endif
@@ -0,0 +1,628 @@
+#include "tablebase.h"
+#include "move.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using std::cout;
+
+// One byte per position. TB_DRAW is a draw, TB_ILLEGAL an index that isn't
+// a legal position (two pieces on a square, a pawn on the back rank, the side
+// not to move in check), anything else is the distance to mate in plies plus
+// one. The side to move wins when the distance is odd and gets mated when it
+// is even.
+constexpr uint8_t TB_DRAW = 0;
+constexpr uint8_t TB_ILLEGAL = 255;
+constexpr int TB_MAX_DISTANCE = 253;
+
+int tb_max_pieces = 0;
+
+static uint8_t distance_code(int plies) { return (uint8_t)(plies + 1); }
+
+static Side opposite(Side side) { return side == WHITE ? BLACK : WHITE; }
+
+static Side piece_side(Piece p) { return p < B_PAWN ? WHITE : BLACK; }
+
+// One material combination, e.g. KRKP. Positions are indexed by the squares
+// of the pieces in a fixed order: white king, black king, white's other
+// pieces strongest first, then black's. White is always the side with more
+// material, a board where black has it is looked up colour flipped.
+struct Table {
+  std::string name;
+  Piece pieces[TB_MAX_PIECES];
+  int piece_count = 0;
+  bool has_pawns = false;
+  int white_material = 0; // material_key() of each side's non-king pieces
+  int black_material = 0;
+  size_t positions = 0; // per side to move
+
+  // tables a capture or promotion leads into come earlier in this order
+  int tier = 0;
+
+  const uint8_t *data = nullptr;
+  size_t map_size = 0;
+};
+
+static int material_key(const Board &board, Side side) {
+  int key = 0;
+  for (int type = W_PAWN; type < W_KING; ++type) {
+    key += popcount(board.piece_bb[type + 6 * side]) << (4 * type);
+  }
+  return key;
+}
+
+static void add_table(std::vector<Table> &list,
+                      const std::vector<int> &white,
+                      const std::vector<int> &black) {
+  const char letters[] = "PNBRQ";
+  Table t;
+  t.pieces[0] = W_KING;
+  t.pieces[1] = B_KING;
+  t.piece_count = 2;
+  int pawns = 0;
+
+  t.name = "K";
+  for (int type : white) {
+    t.name += letters[type];
+    t.pieces[t.piece_count++] = (Piece)type;
+    t.white_material += 1 << (4 * type);
+    pawns += type == W_PAWN;
+  }
+  t.name += "K";
+  for (int type : black) {
+    t.name += letters[type];
+    t.pieces[t.piece_count++] = (Piece)(type + B_PAWN);
+    t.black_material += 1 << (4 * type);
+    pawns += type == W_PAWN;
+  }
+
+  // the first king only goes on files a-d, the rest are mirrored to match.
+  // Without pawns ranks 1-4 are enough as well.
+  t.has_pawns = pawns > 0;
+  t.positions = t.has_pawns ? 32 : 16;
+  for (int i = 1; i < t.piece_count; ++i) {
+    t.positions *= 64;
+  }
+  t.tier = t.piece_count * 8 + pawns;
+  list.push_back(t);
+}
+
+static std::vector<Table> build_table_list() {
+  std::vector<Table> list;
+  for (int a = W_QUEEN; a >= W_PAWN; --a) {
+    add_table(list, {a}, {});
+    for (int b = a; b >= W_PAWN; --b) {
+      add_table(list, {a, b}, {});
+      add_table(list, {a}, {b});
+    }
+  }
+  std::stable_sort(
+      list.begin(), list.end(),
+      [](const Table &x, const Table &y) { return x.tier < y.tier; });
+  return list;
+}
+
+static std::vector<Table> &tables() {
+  static std::vector<Table> list = build_table_list();
+  return list;
+}
+
+// flips (xor on the square) that put the first king on its own squares
+static int canonical_flip(int king, bool has_pawns) {
+  int flip = king % 8 > 3 ? 7 : 0;
+  if (!has_pawns && king / 8 > 3) {
+    flip |= 56;
+  }
+  return flip;
+}
+
+static size_t encode(const Table &t, const int squares[], Side side) {
+  int flip = canonical_flip(squares[0], t.has_pawns);
+  int king = squares[0] ^ flip;
+  size_t index = (king / 8) * 4 + king % 8;
+  for (int i = 1; i < t.piece_count; ++i) {
+    index = index * 64 + (squares[i] ^ flip);
+  }
+  return side * t.positions + index;
+}
+
+static Side decode(const Table &t, size_t index, int squares[]) {
+  Side side = index < t.positions ? WHITE : BLACK;
+  index %= t.positions;
+  for (int i = t.piece_count - 1; i >= 1; --i) {
+    squares[i] = index % 64;
+    index /= 64;
+  }
+  squares[0] = (index / 4) * 8 + index % 4;
+  return side;
+}
+
+// is target attacked by a piece of side by, with the table's pieces on
+// squares and occupancy occ
+static bool attacked(const Table &t, const int squares[], Bitboard occ,
+                     int target, Side by) {
+  for (int i = 0; i < t.piece_count; ++i) {
+    if (piece_side(t.pieces[i]) != by) {
+      continue;
+    }
+    int sq = squares[i];
+    Bitboard attacks = 0;
+    switch (t.pieces[i] % 6) {
+    case W_PAWN:
+      attacks = pawn_attacks[by][sq];
+      break;
+    case W_KNIGHT:
+      attacks = knight_attacks[sq];
+      break;
+    case W_BISHOP:
+      attacks = bishop_attacks(sq, occ);
+      break;
+    case W_ROOK:
+      attacks = rook_attacks(sq, occ);
+      break;
+    case W_QUEEN:
+      attacks = queen_attacks(sq, occ);
+      break;
+    default:
+      attacks = king_attacks[sq];
+      break;
+    }
+    if (attacks & square_bb(target)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static Bitboard occupancy(const Table &t, const int squares[]) {
+  Bitboard occ = 0;
+  for (int i = 0; i < t.piece_count; ++i) {
+    occ |= square_bb(squares[i]);
+  }
+  return occ;
+}
+
+// pieces on separate squares, no pawns on the back ranks and the side that
+// just moved not in check. The kings are always slots 0 and 1, so the king
+// of side s is on squares[s].
+static bool legal_placement(const Table &t, const int squares[], Side side) {
+  Bitboard occ = 0;
+  for (int i = 0; i < t.piece_count; ++i) {
+    int sq = squares[i];
+    if (occ & square_bb(sq)) {
+      return false;
+    }
+    if (t.pieces[i] % 6 == W_PAWN && (sq < 8 || sq >= 56)) {
+      return false;
+    }
+    occ |= square_bb(sq);
+  }
+  return !attacked(t, squares, occ, squares[opposite(side)], side);
+}
+
+// Squares piece p on sq could have come from with a move that neither
+// captured nor promoted. A pawn steps back, two squares if it stands on its
+// fourth rank, anything else moves back the way it came.
+static Bitboard retro_sources(Piece p, int sq, Bitboard occ) {
+  switch (p) {
+  case W_PAWN: {
+    Bitboard from = 0;
+    if (sq / 8 >= 2 && !(occ & square_bb(sq - 8))) {
+      from |= square_bb(sq - 8);
+      if (sq / 8 == 3 && !(occ & square_bb(sq - 16))) {
+        from |= square_bb(sq - 16);
+      }
+    }
+    return from;
+  }
+  case B_PAWN: {
+    Bitboard from = 0;
+    if (sq / 8 <= 5 && !(occ & square_bb(sq + 8))) {
+      from |= square_bb(sq + 8);
+      if (sq / 8 == 4 && !(occ & square_bb(sq + 16))) {
+        from |= square_bb(sq + 16);
+      }
+    }
+    return from;
+  }
+  case W_KNIGHT:
+  case B_KNIGHT:
+    return knight_attacks[sq] & ~occ;
+  case W_BISHOP:
+  case B_BISHOP:
+    return bishop_attacks(sq, occ) & ~occ;
+  case W_ROOK:
+  case B_ROOK:
+    return rook_attacks(sq, occ) & ~occ;
+  case W_QUEEN:
+  case B_QUEEN:
+    return queen_attacks(sq, occ) & ~occ;
+  default:
+    return king_attacks[sq] & ~occ;
+  }
+}
+
+static void unmap_table(Table &t) {
+  if (t.data) {
+    munmap((void *)t.data, t.map_size);
+  }
+  t.data = nullptr;
+  t.map_size = 0;
+}
+
+static bool map_table(Table &t, const std::string &path) {
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size != 2 * t.positions) {
+    ::close(fd);
+    return false;
+  }
+  void *mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (mapped == MAP_FAILED) {
+    return false;
+  }
+  // the search jumps around the table, reading ahead is wasted
+  madvise(mapped, st.st_size, MADV_RANDOM);
+  t.data = (const uint8_t *)mapped;
+  t.map_size = st.st_size;
+  return true;
+}
+
+static std::string table_path(const std::string &dir, const Table &t) {
+  return dir + "/" + t.name + ".tb";
+}
+
+int tb_init(const std::string &dir) {
+  int found = 0;
+  tb_max_pieces = 0;
+  for (Table &t : tables()) {
+    unmap_table(t);
+    if (map_table(t, table_path(dir, t))) {
+      ++found;
+      tb_max_pieces = std::max(tb_max_pieces, t.piece_count);
+    }
+  }
+  return found;
+}
+
+bool tb_probe(const Board &board, int &wdl, int &plies) {
+  if (board.castling_rights || board.en_passant_square != -1) {
+    return false;
+  }
+  int count = popcount(board.occupied);
+  if (count == 2) {
+    wdl = plies = 0;
+    return true;
+  }
+  if (count > tb_max_pieces) {
+    return false;
+  }
+
+  int white = material_key(board, WHITE);
+  int black = material_key(board, BLACK);
+  const Table *table = nullptr;
+  bool flipped = false;
+  for (const Table &t : tables()) {
+    if (t.white_material == white && t.black_material == black) {
+      table = &t;
+      break;
+    }
+    if (t.white_material == black && t.black_material == white) {
+      table = &t;
+      flipped = true;
+      break;
+    }
+  }
+  if (!table || !table->data) {
+    return false;
+  }
+
+  // with black as the stronger side, swap colours and mirror the ranks
+  int mirror = flipped ? 56 : 0;
+  Side strong = flipped ? BLACK : WHITE;
+  int squares[TB_MAX_PIECES];
+  squares[0] = board.king_square[strong] ^ mirror;
+  squares[1] = board.king_square[opposite(strong)] ^ mirror;
+  // pieces of a kind sit next to each other in the table's order
+  for (int i = 2; i < table->piece_count;) {
+    Piece p = table->pieces[i];
+    Bitboard b = board.piece_bb[flipped ? (p + 6) % 12 : p];
+    while (b) {
+      squares[i++] = pop_lsb(b) ^ mirror;
+    }
+  }
+  Side side = flipped ? opposite(board.side_to_move) : board.side_to_move;
+
+  uint8_t v = table->data[encode(*table, squares, side)];
+  if (v == TB_ILLEGAL) {
+    return false;
+  }
+  if (v == TB_DRAW) {
+    wdl = plies = 0;
+  } else {
+    plies = v - 1;
+    wdl = plies % 2 ? 1 : -1;
+  }
+  return true;
+}
+
+// remaining[] value of a position that can't be lost, one of its captures
+// or promotions draws
+constexpr uint8_t LOSS_BLOCKED = 255;
+
+// Retrograde analysis of one table. The tables that its captures and
+// promotions lead into must be loaded, those moves are simply probed.
+struct Generator {
+  const Table &table;
+  size_t size; // both sides to move
+
+  std::vector<uint8_t> value; // the table being built, coded like the files
+
+  // moves staying in the table not yet known to lose, a position is lost
+  // when this gets to 0
+  std::vector<uint8_t> remaining;
+
+  // longest mate against the side to move through a capture or promotion,
+  // a lost position can't be mated sooner than this
+  std::vector<uint8_t> conversion_loss;
+
+  int longest = 0; // highest distance given out so far
+
+  explicit Generator(const Table &table)
+      : table(table), size(2 * table.positions), value(size, TB_DRAW),
+        remaining(size, 0), conversion_loss(size, 0) {}
+
+  void assign(size_t index, int plies) {
+    // can't happen with four pieces, the longest mates are around 70 plies
+    if (plies > TB_MAX_DISTANCE) {
+      return;
+    }
+    value[index] = distance_code(plies);
+    longest = std::max(longest, plies);
+  }
+
+  // Mates and stalemates, counts the moves of every position and scores the
+  // ones leaving the table. A capture or promotion that wins only gives an
+  // upper bound on the distance, a quicker mate may turn up inside the table.
+  bool initialize() {
+    Board board;
+    int squares[TB_MAX_PIECES];
+    for (size_t i = 0; i < size; ++i) {
+      Side side = decode(table, i, squares);
+      if (!legal_placement(table, squares, side)) {
+        value[i] = TB_ILLEGAL;
+        continue;
+      }
+      board.set_pieces(table.pieces, squares, table.piece_count, side);
+
+      MoveList moves;
+      board.generate_legal_moves(moves);
+      if (moves.empty()) {
+        if (board.is_in_check()) {
+          assign(i, 0);
+        }
+        continue;
+      }
+
+      int in_table = 0;
+      int fastest_win = TB_MAX_DISTANCE + 1;
+      int slowest_loss = 0;
+      bool draws = false;
+      for (int m = 0; m < moves.size(); ++m) {
+        Move move = moves[m];
+        if (!move.is_capture() && !move.is_promotion()) {
+          ++in_table;
+          continue;
+        }
+        board.make_move(move);
+        int wdl, plies;
+        bool found = tb_probe(board, wdl, plies);
+        board.unmake_move(move);
+        if (!found) {
+          return false;
+        }
+        if (wdl < 0) {
+          fastest_win = std::min(fastest_win, plies + 1);
+        } else if (wdl > 0) {
+          slowest_loss = std::max(slowest_loss, plies + 1);
+        } else {
+          draws = true;
+        }
+      }
+
+      remaining[i] = draws ? LOSS_BLOCKED : in_table;
+      conversion_loss[i] = slowest_loss;
+      if (fastest_win <= TB_MAX_DISTANCE) {
+        assign(i, fastest_win);
+      } else if (in_table == 0 && !draws) {
+        // every move leaves the table and loses
+        assign(i, slowest_loss);
+      }
+    }
+    return true;
+  }
+
+  // Goes through the distances in order. Every move into a lost position
+  // wins one ply later; a position whose last move left turns out to lose
+  // as well is lost one ply after its slowest one. Positions are found by
+  // undoing the move that led to them, so no move is ever generated twice.
+  void retrograde() {
+    int squares[TB_MAX_PIECES];
+    int before[TB_MAX_PIECES];
+    for (int d = 0; d <= longest; ++d) {
+      uint8_t code = distance_code(d);
+      bool lost = d % 2 == 0;
+      for (size_t i = 0; i < size; ++i) {
+        if (value[i] != code) {
+          continue;
+        }
+        Side side = decode(table, i, squares);
+        Side mover = opposite(side);
+        Bitboard occ = occupancy(table, squares);
+
+        for (int s = 0; s < table.piece_count; ++s) {
+          if (piece_side(table.pieces[s]) != mover) {
+            continue;
+          }
+          Bitboard from = retro_sources(table.pieces[s], squares[s], occ);
+          while (from) {
+            std::copy(squares, squares + table.piece_count, before);
+            before[s] = pop_lsb(from);
+            Bitboard before_occ =
+                occ ^ square_bb(squares[s]) ^ square_bb(before[s]);
+            // the side to move now can't have been in check then
+            if (attacked(table, before, before_occ, before[side], mover)) {
+              continue;
+            }
+
+            size_t p = encode(table, before, mover);
+            uint8_t v = value[p];
+            if (lost) {
+              // a win found earlier can only be a slower capture or
+              // promotion
+              if (v == TB_DRAW || (v != TB_ILLEGAL && v > code + 1)) {
+                assign(p, d + 1);
+              }
+            } else if (v == TB_DRAW && remaining[p] != LOSS_BLOCKED &&
+                       --remaining[p] == 0) {
+              assign(p, std::max<int>(d + 1, conversion_loss[p]));
+            }
+          }
+        }
+      }
+    }
+  }
+};
+
+static std::mutex output_mutex;
+
+// Generates one table and writes it to dir, false if that failed
+static bool generate_table(const Table &t, const std::string &dir) {
+  auto start = std::chrono::steady_clock::now();
+
+  Generator generator(t);
+  if (!generator.initialize()) {
+    std::lock_guard<std::mutex> lock(output_mutex);
+    cout << t.name << ": a table it converts into is missing\n";
+    return false;
+  }
+  generator.retrograde();
+
+  std::ofstream out(table_path(dir, t), std::ios::binary);
+  out.write((const char *)generator.value.data(), generator.size);
+  if (!out) {
+    std::lock_guard<std::mutex> lock(output_mutex);
+    cout << "Could not write " << table_path(dir, t) << '\n';
+    return false;
+  }
+
+  // white to move only, the usual way of quoting these
+  size_t wins = 0, draws = 0, losses = 0;
+  for (size_t i = 0; i < t.positions; ++i) {
+    uint8_t v = generator.value[i];
+    if (v == TB_DRAW) {
+      ++draws;
+    } else if (v != TB_ILLEGAL) {
+      ++((v - 1) % 2 ? wins : losses);
+    }
+  }
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+
+  std::lock_guard<std::mutex> lock(output_mutex);
+  cout << t.name << ": " << wins << " won, " << draws << " drawn, " << losses
+       << " lost with white to move, longest mate " << generator.longest
+       << " plies, " << seconds << " s\n";
+  return true;
+}
+
+// chess_engine gentb [--threads n] [--pieces n] [dir]
+int gentb_command(int argc, char *argv[]) {
+  int threads = std::max(1u, std::thread::hardware_concurrency());
+  int max_pieces = TB_MAX_PIECES;
+  std::string dir = "tablebases";
+  for (int i = 0; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--threads" && i + 1 < argc) {
+      threads = std::max(1, std::atoi(argv[++i]));
+    } else if (arg == "--pieces" && i + 1 < argc) {
+      max_pieces = std::max(3, std::min(std::atoi(argv[++i]), TB_MAX_PIECES));
+    } else {
+      dir = arg;
+    }
+  }
+  mkdir(dir.c_str(), 0755);
+  init_bitboards();
+
+  auto start = std::chrono::steady_clock::now();
+  std::vector<Table> &list = tables();
+
+  // a tier only converts into earlier ones, so its tables are independent
+  // of each other and are built side by side
+  for (size_t first = 0; first < list.size();) {
+    size_t last = first;
+    while (last < list.size() && list[last].tier == list[first].tier) {
+      ++last;
+    }
+    if (list[first].piece_count > max_pieces) {
+      break;
+    }
+
+    // whatever is finished so far, including tables from an earlier run
+    tb_init(dir);
+    std::vector<const Table *> todo;
+    for (size_t i = first; i < last; ++i) {
+      if (list[i].data) {
+        cout << list[i].name << ": already there\n";
+      } else {
+        todo.push_back(&list[i]);
+      }
+    }
+
+    std::atomic<size_t> next{0};
+    std::atomic<bool> failed{false};
+    auto worker = [&]() {
+      for (size_t k; (k = next.fetch_add(1)) < todo.size();) {
+        if (!generate_table(*todo[k], dir)) {
+          failed = true;
+        }
+      }
+    };
+    std::vector<std::thread> pool;
+    int workers = std::min<int>(threads, todo.size());
+    for (int i = 1; i < workers; ++i) {
+      pool.emplace_back(worker);
+    }
+    worker();
+    for (std::thread &t : pool) {
+      t.join();
+    }
+    if (failed) {
+      return 1;
+    }
+    first = last;
+  }
+
+  int found = tb_init(dir);
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+  cout << found << " tables in " << dir << ", " << seconds << " s\n";
+  return 0;
+}
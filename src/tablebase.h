@@ -0,0 +1,29 @@
+#ifndef TABLEBASE_H
+#define TABLEBASE_H
+
+#include "board.h"
+#include <string>
+
+// endgames with up to this many pieces, kings included, get a table
+constexpr int TB_MAX_PIECES = 4;
+
+// most pieces of any table that is loaded, 0 when there are none, so the
+// search can skip probing with a single compare
+extern int tb_max_pieces;
+
+// Maps every table file found in dir (written by gentb), releasing the ones
+// mapped before. Returns how many were found.
+int tb_init(const std::string &dir);
+
+// Looks the position up. wdl is 1 if the side to move wins, -1 if it gets
+// mated and 0 for a draw, plies is the distance to mate with best play on
+// both sides (0 for a draw). False if no loaded table has the position,
+// which is always the case with castling rights or an en passant square.
+// The fifty move rule is not taken into account.
+bool tb_probe(const Board &board, int &wdl, int &plies);
+
+// Entry point for "chess_engine gentb ...": generates the 3 and 4 piece
+// tables by retrograde analysis. Returns the process exit code.
+int gentb_command(int argc, char *argv[]);
+
+#endif
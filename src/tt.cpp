@@ -0,0 +1,89 @@
+#include "tt.h"
+
+TranspositionTable tt;
+
+// data layout, low bit first:
+//   16 bits move, as packed in Move
+//    8 bits depth
+//    2 bits bound
+//   32 bits score
+static uint64_t pack_entry(Move best_move, int depth, Bound bound, int score) {
+  return (uint64_t)best_move.data | ((uint64_t)(depth & 0xFF) << 16) |
+         ((uint64_t)bound << 24) | ((uint64_t)(uint32_t)score << 32);
+}
+
+static void unpack_entry(uint64_t data, TTEntry &entry) {
+  entry.best_move.data = (uint16_t)(data & 0xFFFF);
+  entry.depth = (data >> 16) & 0xFF;
+  entry.bound = (Bound)((data >> 24) & 0x3);
+  entry.score = (int32_t)(uint32_t)(data >> 32);
+}
+
+void TranspositionTable::resize(size_t mb) {
+  size_t count = 1;
+  while (count * 2 * sizeof(TTSlot) <= mb * 1024 * 1024) {
+    count *= 2;
+  }
+
+  slot_count = (mb == 0) ? 0 : count;
+  slots.reset(slot_count ? new TTSlot[slot_count] : nullptr);
+  mask = slot_count ? slot_count - 1 : 0;
+}
+
+void TranspositionTable::clear() {
+  for (size_t i = 0; i < slot_count; ++i) {
+    slots[i].key_xor_data.store(0, std::memory_order_relaxed);
+    slots[i].data.store(0, std::memory_order_relaxed);
+  }
+}
+
+bool TranspositionTable::probe(uint64_t key, TTEntry &entry) const {
+  if (!slot_count) {
+    return false;
+  }
+
+  const TTSlot &slot = slots[key & mask];
+  uint64_t data = slot.data.load(std::memory_order_relaxed);
+  uint64_t check = slot.key_xor_data.load(std::memory_order_relaxed);
+  if ((check ^ data) != key) {
+    return false;
+  }
+
+  unpack_entry(data, entry);
+  if (entry.bound == BOUND_NONE) {
+    return false;
+  }
+  entry.key = key;
+  return true;
+}
+
+void TranspositionTable::store(uint64_t key, int depth, Bound bound, int score,
+                               Move best_move) {
+  if (!slot_count) {
+    return;
+  }
+
+  TTSlot &slot = slots[key & mask];
+  uint64_t old_data = slot.data.load(std::memory_order_relaxed);
+  bool same_key =
+      (slot.key_xor_data.load(std::memory_order_relaxed) ^ old_data) == key;
+
+  if (same_key) {
+    TTEntry old;
+    unpack_entry(old_data, old);
+
+    // keep a deeper result for the same position unless the new one is exact
+    if (old.depth > depth && bound != BOUND_EXACT) {
+      return;
+    }
+
+    // a fail low has no best move, keep the one we had
+    if (best_move.is_none()) {
+      best_move = old.best_move;
+    }
+  }
+
+  uint64_t data = pack_entry(best_move, depth, bound, score);
+  slot.key_xor_data.store(key ^ data, std::memory_order_relaxed);
+  slot.data.store(data, std::memory_order_relaxed);
+}
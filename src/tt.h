@@ -0,0 +1,49 @@
+#ifndef TT_H
+#define TT_H
+
+#include "move.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// what the stored score means relative to the window it was searched with
+enum Bound { BOUND_NONE, BOUND_UPPER, BOUND_LOWER, BOUND_EXACT };
+
+struct TTEntry {
+  uint64_t key = 0;
+  Move best_move;
+  int score = 0;
+  int depth = 0;
+  Bound bound = BOUND_NONE;
+};
+
+// Every thread of a search reads and writes the table without locks. Each
+// slot stores the packed entry next to key ^ data, so a slot torn by two
+// threads writing at once no longer matches its key and reads as a miss.
+struct TTSlot {
+  std::atomic<uint64_t> key_xor_data{0};
+  std::atomic<uint64_t> data{0};
+};
+
+struct TranspositionTable {
+  std::unique_ptr<TTSlot[]> slots;
+  size_t slot_count = 0;
+  uint64_t mask = 0; // slot_count - 1, the count is a power of two
+
+  // Reallocates to the largest power of two slots that fits in mb
+  // megabytes, dropping everything stored so far
+  void resize(size_t mb);
+  void clear();
+
+  // Copies the entry for key into entry, returns false if it is not stored
+  bool probe(uint64_t key, TTEntry &entry) const;
+  void store(uint64_t key, int depth, Bound bound, int score, Move best_move);
+};
+
+constexpr size_t DEFAULT_HASH_MB = 64;
+
+// shared by every search, sized at startup
+extern TranspositionTable tt;
+
+#endif
@@ -0,0 +1,332 @@
+#include "uci.h"
+#include "board.h"
+#include "book.h"
+#include "move.h"
+#include "nnue.h"
+#include "search.h"
+#include "tablebase.h"
+#include "tt.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+
+using std::cout;
+
+constexpr int MAX_HASH_MB = 65536;
+constexpr int MAX_THREADS = 256;
+
+// assume this many moves are left when the GUI doesn't say
+constexpr int DEFAULT_MOVES_TO_GO = 30;
+
+// never plan to use the last few milliseconds of the clock, the GUI and the
+// pipe need some of it
+constexpr int64_t MOVE_OVERHEAD_MS = 50;
+
+// the search thread and the input loop both write lines, keep them whole
+static std::mutex output_mutex;
+
+static void send(const std::string &line) {
+  std::lock_guard<std::mutex> lock(output_mutex);
+  cout << line << std::endl;
+}
+
+// "cp 35" or "mate 3", mates counted in moves from the side to move
+static std::string score_to_uci(int score) {
+  if (score > MATE_BOUND) {
+    return "mate " + std::to_string((CHECKMATE_SCORE - score + 1) / 2);
+  }
+  if (score < -MATE_BOUND) {
+    return "mate " + std::to_string(-(CHECKMATE_SCORE + score) / 2);
+  }
+  return "cp " + std::to_string(score);
+}
+
+// one info line per line of the result, numbered with multipv when there is
+// more than one
+static void send_info(const SearchResult &r) {
+  int64_t ms = (int64_t)(r.seconds * 1000);
+  for (size_t i = 0; i < r.lines.size(); ++i) {
+    const PvLine &pv_line = r.lines[i];
+    std::ostringstream line;
+    line << "info depth " << r.depth;
+    if (r.lines.size() > 1) {
+      line << " multipv " << i + 1;
+    }
+    line << " score " << score_to_uci(pv_line.score) << " nodes " << r.nodes
+         << " nps " << (uint64_t)(r.nodes / std::max(r.seconds, 0.001))
+         << " time " << ms;
+    if (!pv_line.pv.empty()) {
+      line << " pv";
+      for (const Move &m : pv_line.pv) {
+        line << ' ' << move_to_string(m);
+      }
+    }
+    send(line.str());
+  }
+}
+
+// how long to think with remaining ms on the clock: an even share of it over
+// the moves left plus most of the increment
+static int64_t allocate_time(int64_t remaining, int64_t increment,
+                             int moves_to_go) {
+  int moves = moves_to_go > 0 ? moves_to_go : DEFAULT_MOVES_TO_GO;
+  int64_t budget = remaining / moves + increment * 3 / 4;
+  return std::max<int64_t>(1, std::min(budget, remaining - MOVE_OVERHEAD_MS));
+}
+
+struct UciSession {
+  Board board;
+  int threads = 1;
+  int multi_pv = 1;
+  // which pruning the search may use, switched off one at a time for A/B
+  // matches
+  SearchOptions options;
+
+  std::thread worker;
+  std::atomic<bool> stop{false};
+  // go infinite must not answer bestmove until told to stop
+  bool infinite = false;
+
+  // stops the search in progress (if any) and waits for its bestmove
+  void stop_search() {
+    stop = true;
+    if (worker.joinable()) {
+      worker.join();
+    }
+  }
+
+  void position(std::istringstream &args);
+  void go(std::istringstream &args);
+  void set_option(std::istringstream &args);
+};
+
+// position startpos [moves ...] | position fen <fen> [moves ...]
+void UciSession::position(std::istringstream &args) {
+  std::string token, fen;
+  args >> token;
+  if (token == "startpos") {
+    fen = START_FEN;
+    args >> token; // "moves", if there are any
+  } else if (token == "fen") {
+    while (args >> token && token != "moves") {
+      fen += token + ' ';
+    }
+  } else {
+    return;
+  }
+
+  if (!board.set_fen(fen)) {
+    send("info string invalid fen " + fen);
+    return;
+  }
+
+  while (args >> token) {
+    Move m = parse_move(board, token);
+    if (m.is_none()) {
+      send("info string illegal move " + token);
+      return;
+    }
+    board.make_move(m);
+  }
+}
+
+void UciSession::go(std::istringstream &args) {
+  SearchLimits limits;
+  int64_t time[2] = {0, 0};
+  int64_t increment[2] = {0, 0};
+  int moves_to_go = 0;
+  int64_t move_time = 0;
+  bool any_limit = false;
+
+  std::string token;
+  while (args >> token) {
+    if (token == "depth") {
+      args >> limits.depth;
+      limits.depth = std::max(1, std::min(limits.depth, MAX_PLY - 1));
+      any_limit = true;
+    } else if (token == "movetime") {
+      args >> move_time;
+      any_limit = true;
+    } else if (token == "wtime") {
+      args >> time[WHITE];
+      any_limit = true;
+    } else if (token == "btime") {
+      args >> time[BLACK];
+      any_limit = true;
+    } else if (token == "winc") {
+      args >> increment[WHITE];
+    } else if (token == "binc") {
+      args >> increment[BLACK];
+    } else if (token == "movestogo") {
+      args >> moves_to_go;
+    } else if (token == "nodes") {
+      args >> limits.nodes;
+      any_limit = true;
+    }
+  }
+
+  int64_t budget = move_time;
+  if (budget == 0 && time[board.side_to_move] > 0) {
+    budget = allocate_time(time[board.side_to_move],
+                           increment[board.side_to_move], moves_to_go);
+  }
+  if (budget > 0) {
+    SearchLimits timed = time_limits(budget);
+    limits.soft_time_ms = timed.soft_time_ms;
+    limits.hard_time_ms = timed.hard_time_ms;
+  }
+
+  // plain "go" and "go infinite" search until stop
+  infinite = !any_limit;
+
+  // a book move is answered straight away, an infinite search is analysis
+  // and still wants the search
+  Move book_move = infinite ? Move() : book.probe(board);
+  if (!book_move.is_none()) {
+    send("bestmove " + move_to_string(book_move));
+    return;
+  }
+  limits.threads = threads;
+  limits.options = options;
+  limits.multi_pv = multi_pv;
+  limits.stop = &stop;
+  limits.on_iteration = send_info;
+
+  stop = false;
+  Board root = board;
+  worker = std::thread([this, root, limits] {
+    SearchResult result = search(root, limits, tt);
+    if (stats_enabled) {
+      std::lock_guard<std::mutex> lock(output_mutex);
+      std::cerr << search_stats_json(result) << std::endl;
+    }
+
+    // a finished infinite search still waits for stop before answering
+    while (infinite && !stop.load()) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    // mated or stalemated, there is no iteration to report and no move
+    if (result.best_move.is_none()) {
+      send("info depth 0 score " + score_to_uci(result.score));
+      send("bestmove 0000");
+      return;
+    }
+    send("bestmove " + move_to_string(result.best_move));
+  });
+}
+
+// setoption name <id> [value <x>]
+void UciSession::set_option(std::istringstream &args) {
+  std::string token, name, value;
+  args >> token; // "name"
+  while (args >> token && token != "value") {
+    name += (name.empty() ? "" : " ") + token;
+  }
+  while (args >> token) {
+    value += (value.empty() ? "" : " ") + token;
+  }
+
+  if (name == "Hash") {
+    tt.resize(std::max(1, std::min(std::atoi(value.c_str()), MAX_HASH_MB)));
+  } else if (name == "Threads") {
+    threads = std::max(1, std::min(std::atoi(value.c_str()), MAX_THREADS));
+  } else if (name == "MultiPV") {
+    multi_pv = std::max(1, std::min(std::atoi(value.c_str()), MAX_MOVES));
+  } else if (name == "BookFile") {
+    if (value.empty() || value == "<empty>") {
+      book.close();
+    } else if (!book.open(value)) {
+      send("info string could not open book " + value);
+    }
+  } else if (name == "BookBestMove") {
+    book.best_move_only = value == "true";
+  } else if (name == "TablebasePath") {
+    std::string dir = value == "<empty>" ? "" : value;
+    if (tb_init(dir) == 0 && !dir.empty()) {
+      send("info string no tablebases found in " + dir);
+    }
+  } else if (name == "NullMove") {
+    options.null_move = value == "true";
+  } else if (name == "LMR") {
+    options.late_move_reductions = value == "true";
+  } else if (name == "Futility") {
+    options.futility = value == "true";
+  } else if (name == "EvalFile") {
+    if (nnue_load(value)) {
+      // the accumulator is only kept while a network is loaded, rebuild it
+      board.set_fen(START_FEN);
+    } else {
+      send("info string could not load network " + value);
+    }
+  } else {
+    send("info string unknown option " + name);
+  }
+}
+
+// false once the GUI has said quit
+static bool handle_command(UciSession &session, const std::string &line) {
+  std::istringstream args(line);
+  std::string command;
+  args >> command;
+
+  if (command == "uci") {
+    send("id name cpp_chess");
+    send("id author cpp_chess authors");
+    send("option name Hash type spin default " +
+         std::to_string(DEFAULT_HASH_MB) + " min 1 max " +
+         std::to_string(MAX_HASH_MB));
+    send("option name Threads type spin default " +
+         std::to_string(session.threads) + " min 1 max " +
+         std::to_string(MAX_THREADS));
+    send("option name MultiPV type spin default 1 min 1 max " +
+         std::to_string(MAX_MOVES));
+    send("option name EvalFile type string default <empty>");
+    send("option name BookFile type string default <empty>");
+    send("option name BookBestMove type check default false");
+    send("option name TablebasePath type string default <empty>");
+    send("option name NullMove type check default true");
+    send("option name LMR type check default true");
+    send("option name Futility type check default true");
+    send("uciok");
+  } else if (command == "isready") {
+    send("readyok");
+  } else if (command == "ucinewgame") {
+    session.stop_search();
+    tt.clear();
+  } else if (command == "position") {
+    session.stop_search();
+    session.position(args);
+  } else if (command == "go") {
+    session.stop_search();
+    session.go(args);
+  } else if (command == "stop") {
+    session.stop_search();
+  } else if (command == "setoption") {
+    session.stop_search();
+    session.set_option(args);
+  } else if (command == "quit") {
+    return false;
+  }
+  return true;
+}
+
+int uci_loop(int threads, const std::string &first_command) {
+  UciSession session;
+  session.threads = threads;
+
+  bool running =
+      first_command.empty() || handle_command(session, first_command);
+  std::string line;
+  while (running && std::getline(std::cin, line)) {
+    running = handle_command(session, line);
+  }
+
+  session.stop_search();
+  return 0;
+}
@@ -0,0 +1,13 @@
+#ifndef UCI_H
+#define UCI_H
+
+#include <string>
+
+// Speaks the UCI protocol on stdin/stdout until "quit" or end of input. The
+// search runs on its own thread so "stop" and "isready" are answered while it
+// thinks. threads is the starting value of the Threads option, and
+// first_command is a line that was already read (the game loop hands over
+// the "uci" it got). Returns the process exit code.
+int uci_loop(int threads, const std::string &first_command = "");
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef ZOBRIST_H
+#define ZOBRIST_H
+
+#include <cstdint>
+
+// random keys xored together to give every position a 64-bit hash
+extern uint64_t zobrist_pieces[12][64]; // [Piece][square]
+extern uint64_t zobrist_side;           // xored in when black is to move
+extern uint64_t zobrist_castling[16];   // [castling_rights]
+extern uint64_t zobrist_en_passant[8];  // [file of the en passant square]
+
+// The Polyglot book key table, laid out as in the Polyglot format: 768
+// piece keys (64 * kind + square, kinds ordered bp wp bn wn ... bk wk), 4
+// castling keys, 8 en passant file keys and the white to move key.
+constexpr int POLYGLOT_CASTLING = 768;
+constexpr int POLYGLOT_EN_PASSANT = 772;
+constexpr int POLYGLOT_TURN = 780;
+extern const uint64_t polyglot_random[781];
+
+// Fills the key tables, only does the work the first time it is called
+void init_zobrist();
+
+#endif